@@ -0,0 +1,253 @@
+/*
+****************************************
+* This file contains the definitions of
+* the batch mode.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <sstream>
+#include "batch.hpp"
+#include "util.hpp"
+#include "metrics.hpp"
+
+using namespace cv;
+using namespace std;
+
+BatchRunner::BatchRunner(const BlockMatchingCorrelation &settings, int numThreads, size_t memoryBudgetMB)
+    : settings(settings), pool(numThreads), budget(memoryBudgetMB * 1024 * 1024), reserved(0), running(0)
+{
+}
+
+bool BatchRunner::loadManifest(const String &manifest)
+{
+    ifstream file(manifest);
+    string line;
+    if (!file)
+    {
+        cout << "Could not open the manifest " << manifest << endl;
+        return false;
+    }
+    while (getline(file, line))
+    {
+        istringstream fields(line);
+        string input, output;
+        if (!(fields >> input) || input[0] == '#')
+            continue;
+        if (!(fields >> output))
+        {
+            cout << "No output video for " << input << " in the manifest" << endl;
+            return false;
+        }
+
+        unique_ptr<BatchJob> job(new BatchJob());
+        job->input = input;
+        job->output = output;
+        VideoCapture cap(input);
+        if (!cap.isOpened())
+        {
+            cout << "Error opening video stream or file " << input << endl;
+            job->state = JOB_FAILED;
+        }
+        else
+        {
+            job->inputSize = Size((int)cap.get(CAP_PROP_FRAME_WIDTH), (int)cap.get(CAP_PROP_FRAME_HEIGHT));
+            job->totalFrames = (int)cap.get(CAP_PROP_FRAME_COUNT);
+            job->frameSize = needsTiling(job->inputSize) ? job->inputSize : Size(FRAME_WIDTH, FRAME_HEIGHT);
+            job->memory = (size_t)job->frameSize.area() * 3 * BATCH_FRAME_COPIES;
+        }
+        jobs.push_back(move(job));
+    }
+    return true;
+}
+
+void BatchRunner::admitJobs()
+{
+    // jobs start in manifest order while the budget allows, a job larger than the whole budget runs alone
+    lock_guard<mutex> guard(admitLock);
+    for (auto &job : jobs)
+    {
+        if (job->state != JOB_QUEUED)
+            continue;
+        if (running > 0 && (running >= pool.size() || reserved + job->memory > budget))
+            break;
+        // the start time is written before the state, printProgress only reads it from a running job
+        job->start = chrono::steady_clock::now();
+        job->state = JOB_RUNNING;
+        reserved += job->memory;
+        running++;
+
+        BatchJob *p = job.get();
+        pool.submit([this, p] {
+            if (startJob(p))
+                runJob(p);
+        });
+    }
+}
+
+bool BatchRunner::startJob(BatchJob *job)
+{
+    float fps;
+
+    job->cap.open(job->input);
+    if (!job->cap.isOpened())
+    {
+        cout << "Error opening video stream or file " << job->input << endl;
+        finishJob(job, JOB_FAILED);
+        return false;
+    }
+    fps = (float)job->cap.get(CAP_PROP_FPS);
+    job->cap >> job->prev;
+    if (job->prev.empty())
+    {
+        cout << job->input << " has no frames" << endl;
+        finishJob(job, JOB_FAILED);
+        return false;
+    }
+    if (job->prev.size() != job->frameSize)
+        resize(job->prev, job->prev, job->frameSize);
+
+    job->writer.open(job->output, VideoWriter::fourcc('X', 'V', 'I', 'D'), settings.getRateFactor() * fps, job->frameSize);
+    if (!job->writer.isOpened())
+    {
+        cout << "Could not create the output video " << job->output << endl;
+        finishJob(job, JOB_FAILED);
+        return false;
+    }
+
+    if (job->frameSize != Size(FRAME_WIDTH, FRAME_HEIGHT))
+    {
+        job->tiledEngine.reset(new TiledInterpolator(settings));
+    }
+    else
+    {
+        job->engine.reset(new BlockMatchingCorrelation(job->input));
+        job->engine->copySettings(settings);
+        job->engine->setVerbose(false);
+    }
+    return true;
+}
+
+void BatchRunner::runJob(BatchJob *job)
+{
+    int rateFactor = settings.getRateFactor();
+
+    for (int n = 0; n < BATCH_PAIRS_PER_TASK; n++)
+    {
+        UMat curr;
+        job->cap >> curr;
+        if (curr.empty())
+        {
+            job->writer << job->prev; // last frame of the video
+            job->framesDone++;
+            finishJob(job, JOB_DONE);
+            return;
+        }
+        if (curr.size() != job->frameSize)
+            resize(curr, curr, job->frameSize);
+
+        auto start = chrono::steady_clock::now();
+        if (job->tiledEngine)
+            job->tiledEngine->motionEstimation(job->prev, curr);
+        else
+            job->engine->motionEstimation(job->prev, curr);
+
+        job->writer << job->prev;
+        for (int k = 1; k < rateFactor; k++)
+        {
+            UMat interpolatedFrame;
+            if (job->tiledEngine)
+                job->tiledEngine->motionCompensation(job->prev, curr, interpolatedFrame, (double)k / rateFactor);
+            else
+                job->engine->motionCompensation(job->prev, curr, interpolatedFrame, (double)k / rateFactor);
+            job->writer << interpolatedFrame;
+        }
+        // the metrics count the pairs of all jobs, the tiled engines have no stage timings
+        getMetrics().pairDone(job->framesDone, job->engine ? job->engine->getStageTimes() : StageTimes(), msSince(start));
+        job->prev = curr;
+        job->framesDone++;
+    }
+    // let the other jobs run, this job continues from its worker's queue unless it is stolen
+    pool.submit([this, job] { runJob(job); });
+}
+
+void BatchRunner::finishJob(BatchJob *job, JobState state)
+{
+    job->cap.release();
+    job->writer.release();
+    job->engine.reset();
+    job->tiledEngine.reset();
+    job->prev.release();
+    job->stop = chrono::steady_clock::now();
+    {
+        lock_guard<mutex> guard(admitLock);
+        reserved -= job->memory;
+        running--;
+    }
+    job->state = state; // set last, the main thread stops reporting once every job is finished
+    admitJobs();
+}
+
+void BatchRunner::printProgress()
+{
+    auto now = chrono::steady_clock::now();
+    for (size_t k = 0; k < jobs.size(); k++)
+    {
+        BatchJob &job = *jobs[k];
+        if (job.state != JOB_RUNNING)
+            continue;
+        double seconds = chrono::duration<double>(now - job.start).count();
+        double fps = seconds > 0 ? job.framesDone / seconds : 0.0;
+        cout << "Job " << k << " (" << job.input << ") : " << job.framesDone.load() << "/" << job.totalFrames << " frames, "
+             << fps << " fps";
+        if (fps > 0 && job.totalFrames > job.framesDone)
+            cout << ", ETA " << (int)((job.totalFrames - job.framesDone) / fps) << " s";
+        cout << endl;
+    }
+}
+
+bool BatchRunner::run(const String &manifest)
+{
+    bool success = true;
+
+    if (!loadManifest(manifest))
+        return false;
+
+    // the pool provides the parallelism, OpenCV's own threads would oversubscribe the cores
+    int previousThreads = getNumThreads();
+    setNumThreads(1);
+    int totalPairs = 0;
+    for (auto &job : jobs)
+        totalPairs += max(0, job->totalFrames - 1);
+    getMetrics().beginRun(manifest, totalPairs);
+    cout << "Batch of " << jobs.size() << " jobs on " << pool.size() << " threads, memory budget " << (budget >> 20) << " MB" << endl;
+    admitJobs();
+
+    while (1)
+    {
+        bool finished = true;
+        for (auto &job : jobs)
+            finished = finished && (job->state == JOB_DONE || job->state == JOB_FAILED);
+        if (finished)
+            break;
+        this_thread::sleep_for(chrono::seconds(1));
+        printProgress();
+    }
+    pool.wait();
+    setNumThreads(previousThreads);
+
+    for (size_t k = 0; k < jobs.size(); k++)
+    {
+        BatchJob &job = *jobs[k];
+        if (job.state == JOB_FAILED)
+        {
+            cout << "Job " << k << " (" << job.input << ") failed" << endl;
+            success = false;
+            continue;
+        }
+        double seconds = chrono::duration<double>(job.stop - job.start).count();
+        cout << "Job " << k << " (" << job.input << ") : " << job.framesDone.load() << " frames in " << seconds << " s ("
+             << (seconds > 0 ? job.framesDone / seconds : 0.0) << " fps), output " << job.output << endl;
+    }
+    return success;
+}
@@ -0,0 +1,82 @@
+/*
+****************************************
+* This file contains the declaration
+* of the batch mode. A manifest lists
+* input and output videos, the jobs run
+* concurrently on a shared work-stealing
+* thread pool within a memory budget.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+/*
+* Manifest format : one job per line, the input path and the output path separated by whitespace.
+* Empty lines and lines starting with '#' are ignored.
+*   video/penguin_30_part1.mp4  video/penguin_60_part1.avi
+*   video/penguin_30_part2.mp4  video/penguin_60_part2.avi
+*/
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include "bmc.hpp"
+#include "tiling.hpp"
+#include "thread_pool.hpp"
+
+using namespace cv;
+using namespace std;
+
+enum JobState
+{
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED
+};
+
+struct BatchJob
+{
+    String input, output;
+    Size inputSize, frameSize; // frameSize is the size the engine works on
+    int totalFrames;
+    size_t memory; // bytes reserved from the budget while the job runs
+    atomic<int> framesDone;
+    atomic<int> state;
+    chrono::steady_clock::time_point start, stop; // written before state is published
+
+    VideoCapture cap;
+    VideoWriter writer;
+    unique_ptr<BlockMatchingCorrelation> engine;
+    unique_ptr<TiledInterpolator> tiledEngine; // used instead of engine for inputs larger than the frame size
+    UMat prev;
+
+    BatchJob() : totalFrames(0), memory(0), framesDone(0), state(JOB_QUEUED) {}
+};
+
+class BatchRunner
+{
+    const BlockMatchingCorrelation &settings;
+    vector<unique_ptr<BatchJob>> jobs;
+    WorkStealingPool pool;
+    mutex admitLock;
+    size_t budget, reserved;
+    int running;
+
+    bool loadManifest(const String &manifest);
+    void admitJobs();
+    bool startJob(BatchJob *job);
+    void runJob(BatchJob *job);
+    void finishJob(BatchJob *job, JobState state);
+    void printProgress();
+
+public:
+    BatchRunner(const BlockMatchingCorrelation &settings, int numThreads, size_t memoryBudgetMB);
+    bool run(const String &manifest);
+};
+
+#endif
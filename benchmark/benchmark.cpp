@@ -0,0 +1,400 @@
+/*
+****************************************
+* This file contains the benchmark of
+* the BMC algorithm on synthetic clips.
+* No video codec is involved, the frames
+* are generated in memory and passed to
+* BMC() directly.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <iomanip>
+#include <sstream>
+#include "benchmark.hpp"
+
+void scorePair(const vector<vector<Point2f>> &found, const vector<vector<Point2f>> &trueMV, const vector<vector<BlockTruth>> &blockTruth, ClipScore &score)
+{
+    for (int i = 0; i < NUM_BLOCKS_Y; i++)
+    {
+        for (int j = 0; j < NUM_BLOCKS_X; j++)
+        {
+            double error = norm(found[i][j] - trueMV[i][j]);
+            if (blockTruth[i][j] == TRUTH_BOUNDARY)
+            {
+                score.boundaryErrorSum += error;
+                score.boundaryBlocks++;
+                continue;
+            }
+            score.errorSum += error;
+            score.interiorBlocks++;
+            if (error <= 1.0)
+                score.within1++;
+            if (error <= 0.5)
+                score.withinHalf++;
+        }
+    }
+}
+
+void runClip(const SyntheticClip &clip, const BlockMatchingCorrelation &settings, int numFrames, ClipScore &score)
+{
+    BlockMatchingCorrelation bmcObj("");
+    vector<vector<Point2f>> trueMV;
+    vector<vector<BlockTruth>> blockTruth;
+    UMat prev, interpolatedFrame, trueFrame;
+    PoolAllocator &pool = getPoolAllocator();
+
+    bmcObj.copySettings(settings);
+    bmcObj.setVerbose(false);
+    memset(&score, 0, sizeof(score));
+    clip.frame(0, prev);
+    for (int t = 0; t + 1 < numFrames; t++)
+    {
+        UMat curr;
+        if (pool.isInstalled())
+            pool.beginFrame();
+        clip.frame(t + 1, curr);
+
+        auto start = chrono::steady_clock::now();
+        bmcObj.BMC(prev, curr, interpolatedFrame);
+        score.totalMs += msSince(start);
+
+        const StageTimes &times = bmcObj.getStageTimes();
+        score.times.globalCPPC += times.globalCPPC;
+        score.times.localCPPC += times.localCPPC;
+        score.times.BM += times.BM;
+        score.times.MC += times.MC;
+
+        clip.frame(t + 0.5, trueFrame);
+        score.psnrSum += PSNR(interpolatedFrame, trueFrame);
+
+        // the model fitted to a pan must move the whole frame, its center included, by the pan
+        Matx33d H;
+        if (settings.getGlobalModelType() != GLOBAL_OFF && clip.isPan())
+        {
+            score.globalPairs++;
+            if (bmcObj.getGlobalMotion(H))
+            {
+                Point2f center(FRAME_WIDTH / 2.0f, FRAME_HEIGHT / 2.0f);
+                Vec3d moved = H * Vec3d(center.x, center.y, 1.0);
+                score.globalFits++;
+                score.globalErrorSum += norm(Point2f((float)(moved[0] / moved[2]), (float)(moved[1] / moved[2])) - center - clip.getPan());
+            }
+        }
+
+        clip.truth(t, trueMV, blockTruth);
+        scorePair(bmcObj.getBlockMV(), trueMV, blockTruth, score);
+        score.pairs++;
+        prev = curr;
+        if (pool.isInstalled() && t >= BENCHMARK_POOL_WARMUP)
+        {
+            score.steadyPairs++;
+            score.steadySystemAllocations += pool.frameTotal().systemAllocations;
+        }
+    }
+    score.sadPixels = bmcObj.getSADPixels();
+}
+
+void writeScore(ostream &out, const String &name, const ClipScore &score)
+{
+    double pairs = max(1, score.pairs);
+    out << left << setw(14) << name << right << fixed << setprecision(3)
+        << setw(9) << score.errorSum / max<size_t>(1, score.interiorBlocks)
+        << setw(9) << 100.0 * score.within1 / max<size_t>(1, score.interiorBlocks)
+        << setw(9) << 100.0 * score.withinHalf / max<size_t>(1, score.interiorBlocks)
+        << setw(9) << score.boundaryErrorSum / max<size_t>(1, score.boundaryBlocks)
+        << setprecision(2)
+        << setw(9) << score.psnrSum / pairs
+        << setw(9) << score.sadPixels / 1e6 / pairs
+        << setprecision(1)
+        << setw(9) << score.times.globalCPPC / pairs
+        << setw(9) << score.times.localCPPC / pairs
+        << setw(9) << score.times.BM / pairs
+        << setw(9) << score.times.MC / pairs
+        << setw(9) << score.totalMs / pairs << "\n";
+}
+
+bool readBaseline(const String &fileName, map<String, ClipLimits> &limits)
+{
+    /* one line per clip : name, largest EPE and largest time per frame pair, # starts a comment */
+    ifstream file(fileName);
+    String line;
+    if (!file)
+    {
+        cout << "Could not open the baseline " << fileName << endl;
+        return false;
+    }
+    limits.clear();
+    while (getline(file, line))
+    {
+        istringstream fields(line);
+        String name;
+        ClipLimits clip;
+        if (!(fields >> name) || name[0] == '#')
+            continue;
+        if (!(fields >> clip.maxEPE >> clip.maxMs))
+        {
+            cout << "Invalid line in the baseline " << fileName << " : " << line << endl;
+            return false;
+        }
+        limits[name] = clip;
+    }
+    return true;
+}
+
+bool writeBaseline(const String &fileName, const vector<pair<String, ClipScore>> &scores)
+{
+    /* the limits are the scores of this run with a margin, for the machine the run was made on */
+    ofstream file(fileName);
+    if (!file)
+    {
+        cout << "Could not write the baseline " << fileName << endl;
+        return false;
+    }
+    file << "# clip, largest EPE (pixels), largest time per frame pair (ms)\n";
+    for (auto &clip : scores)
+    {
+        const ClipScore &score = clip.second;
+        file << clip.first << " " << fixed << setprecision(3)
+             << score.errorSum / max<size_t>(1, score.interiorBlocks) + BENCHMARK_EPE_MARGIN << " " << setprecision(1)
+             << BENCHMARK_TIME_MARGIN * score.totalMs / max(1, score.pairs) << "\n";
+    }
+    return true;
+}
+
+bool checkScore(ostream &out, const String &name, const ClipScore &score, const ClipLimits &limits)
+{
+    double EPE = score.errorSum / max<size_t>(1, score.interiorBlocks);
+    double ms = score.totalMs / max(1, score.pairs);
+    bool pass = true;
+    if (EPE > limits.maxEPE)
+    {
+        out << "REGRESSION " << name << " : EPE " << EPE << " px, the limit is " << limits.maxEPE << " px\n";
+        pass = false;
+    }
+    if (ms > limits.maxMs)
+    {
+        out << "REGRESSION " << name << " : " << ms << " ms per frame pair, the limit is " << limits.maxMs << " ms\n";
+        pass = false;
+    }
+    return pass;
+}
+
+bool checkGlobalMotion(ostream &out, const String &name, const ClipScore &score)
+{
+    /* every pair of a pan must be fitted, with the pan as the motion of the frame center */
+    if (score.globalPairs == 0)
+        return true;
+    double error = score.globalErrorSum / max(1, score.globalFits);
+    out << "Global motion " << name << " : fitted " << score.globalFits << " of " << score.globalPairs << " pairs, error " << error << " px\n";
+    if (score.globalFits < score.globalPairs || error > BENCHMARK_GLOBAL_ERROR)
+    {
+        out << "REGRESSION " << name << " : the global motion does not match the pan\n";
+        return false;
+    }
+    return true;
+}
+
+bool checkDedup(ostream &out, int numFrames)
+{
+    /* a still background with one small object moving and every third frame repeated : the repeats
+       must be found, and the frames where only the object moved must not be taken for repeats */
+    SyntheticClip clip("small-object", Point2f(0, 0), 6);
+    vector<UMat> frames;
+    vector<int> keyFrames, expected;
+    DedupStats stats;
+    clip.addObject(Point2f(900, 500), Point2f(3, 2), Size(48, 48), 61);
+    for (int t = 0; t < numFrames; t++)
+    {
+        UMat fr;
+        clip.frame(t, fr);
+        expected.push_back((int)frames.size());
+        frames.push_back(fr);
+        if (t % 3 == 2 && t + 1 < numFrames)
+            frames.push_back(fr.clone());
+    }
+    findKeyFrames(frames, 0, keyFrames, stats);
+    bool pass = keyFrames == expected;
+    out << "Repeated frames " << clip.name << " : " << stats.duplicates << " found, " << frames.size() - expected.size() << " inserted, "
+        << keyFrames.size() << " key frames of " << expected.size() << "\n";
+    if (!pass)
+        out << "REGRESSION " << clip.name << " : the repeated frames were not told apart from the local motion\n";
+    return pass;
+}
+
+bool checkPool(ostream &out, const String &name, const ClipScore &score)
+{
+    /* once the pool is warm, a frame pair must take every buffer from it */
+    if (score.steadyPairs == 0)
+        return true;
+    out << "Pool " << name << " : " << score.steadySystemAllocations << " system allocations in " << score.steadyPairs << " pairs after the warm-up\n";
+    if (score.steadySystemAllocations > 0)
+    {
+        out << "REGRESSION " << name << " : the steady state frames allocate from the system\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BlockMatchingCorrelation settings("");
+    int numFrames = BENCHMARK_FRAMES;
+    String config;
+    String baselineFile = BENCHMARK_BASELINE;
+    bool check = false, updateBaseline = false, dedup = false;
+    map<String, ClipLimits> limits;
+    vector<pair<String, ClipScore>> scores;
+
+    for (int i = 1; i < argc; i++)
+        config += String(" ") + argv[i];
+    for (int i = 1; i < argc; i++)
+    {
+        String option = argv[i];
+        if (option == "--check")
+            check = true;
+        else if (option == "--update-baseline")
+            updateBaseline = true;
+        else if (option == "--baseline" && i + 1 < argc)
+            baselineFile = argv[++i];
+        else if (option == "--frames" && i + 1 < argc)
+            numFrames = max(2, atoi(argv[++i]));
+        else if (option == "--preset" && i + 1 < argc)
+        {
+            if (!settings.setPreset(argv[++i]))
+            {
+                cout << "Unknown preset " << argv[i] << endl;
+                return -1;
+            }
+        }
+        else if (option == "--peaks" && i + 1 < argc)
+            settings.setNumPeaks(max(1, atoi(argv[++i])));
+        else if (option == "--float-me")
+            settings.setIntegerME(false);
+        else if (option == "--reuse-cppc")
+            settings.setCPPCReuse(true);
+        else if (option == "--quadtree")
+            settings.setQuadtree(true);
+        else if (option == "--dedup")
+            dedup = true;
+        else if (option == "--pool")
+            getPoolAllocator().install();
+        else if (option == "--global-motion" && i + 1 < argc)
+        {
+            if (!settings.setGlobalModel(argv[++i]))
+            {
+                cout << "Unknown global motion model " << argv[i] << endl;
+                return -1;
+            }
+        }
+        else
+        {
+            cout << "Usage : ./benchmark [--frames N] [--preset name] [--peaks K] [--float-me] [--reuse-cppc] [--quadtree]\n"
+                 << "                   [--global-motion model] [--dedup] [--pool]\n"
+                 << "                   [--check] [--update-baseline] [--baseline file]" << endl;
+            return -1;
+        }
+    }
+    if (check && !readBaseline(baselineFile, limits))
+        return -1;
+
+    vector<SyntheticClip> clips;
+    buildCorpus(clips);
+    ofstream resFile(BENCHMARK_FILE, ios_base::app);
+    ostringstream table;
+    table << "Benchmark" << (config.empty() ? " (default settings)" : config) << ", " << numFrames << " frames per clip\n"
+          << "clip               EPE    <=1px  <=0.5px  edgeEPE  PSNR dB   SADMpx  gCPPCms  lCPPCms     BMms     MCms  totalms\n";
+
+    ClipScore total;
+    memset(&total, 0, sizeof(total));
+    for (auto &clip : clips)
+    {
+        ClipScore score;
+        cout << "Running " << clip.name << " ..." << endl;
+        runClip(clip, settings, numFrames, score);
+        writeScore(table, clip.name, score);
+        scores.push_back(make_pair(clip.name, score));
+
+        total.pairs += score.pairs;
+        total.errorSum += score.errorSum;
+        total.boundaryErrorSum += score.boundaryErrorSum;
+        total.interiorBlocks += score.interiorBlocks;
+        total.boundaryBlocks += score.boundaryBlocks;
+        total.within1 += score.within1;
+        total.withinHalf += score.withinHalf;
+        total.psnrSum += score.psnrSum;
+        total.sadPixels += score.sadPixels;
+        total.times.globalCPPC += score.times.globalCPPC;
+        total.times.localCPPC += score.times.localCPPC;
+        total.times.BM += score.times.BM;
+        total.times.MC += score.times.MC;
+        total.totalMs += score.totalMs;
+    }
+    writeScore(table, "all", total);
+
+    // a clip without limits in the baseline fails the check, so that a new clip cannot go unchecked
+    bool pass = true;
+    for (auto &clip : scores)
+    {
+        if (!check)
+            break;
+        if (limits.count(clip.first) == 0)
+        {
+            table << "REGRESSION " << clip.first << " : the clip has no limits in " << baselineFile << "\n";
+            pass = false;
+            continue;
+        }
+        pass = checkScore(table, clip.first, clip.second, limits[clip.first]) && pass;
+    }
+    for (auto &clip : scores)
+        pass = checkGlobalMotion(table, clip.first, clip.second) && pass;
+    for (auto &clip : scores)
+        pass = checkPool(table, clip.first, clip.second) && pass;
+    if (dedup)
+        pass = checkDedup(table, numFrames) && pass;
+    if (check)
+        table << (pass ? "All clips are within the limits of " : "Some clips are outside the limits of ") << baselineFile << "\n";
+
+    cout << table.str();
+    resFile << table.str() << "\n";
+    resFile.close();
+    if (updateBaseline && !writeBaseline(baselineFile, scores))
+        return -1;
+    return pass ? 0 : 1; // 1 when a clip regressed, -1 for errors
+}
+
+/*
+Errors are end point errors in pixels between the vector found for a block and its true motion,
+times are milliseconds per frame pair and SADMpx the Mpixels compared by block matching per frame pair. Blocks on object edges or in covered / uncovered regions
+have no single true vector and are scored apart (edgeEPE). PSNR compares the frame interpolated
+halfway between two frames with the true frame rendered at that time.
+
+With --global-motion the model fitted to every pair of the pan clips must move the frame center by
+the pan, within BENCHMARK_GLOBAL_ERROR pixels :
+make check-global
+
+With --dedup a clip where only a small object moves, with repeated frames inserted, must have exactly
+the inserted frames found as repeats :
+make check-dedup
+
+With --pool the pooling allocator is installed and the pairs after the first BENCHMARK_POOL_WARMUP of
+every clip must not allocate from the system :
+make check-pool
+
+The exit status is 1 when --check finds a clip outside the limits of the baseline (baseline.txt
+holds the limits of the default settings), so that the benchmark can gate a change :
+make check
+--update-baseline rewrites the baseline from the scores of the run, with BENCHMARK_EPE_MARGIN and
+BENCHMARK_TIME_MARGIN added. The time limits only hold for the machine they were measured on.
+
+To compile from terminal, execute the following commad :
+make
+
+Usage :
+./benchmark
+./benchmark --preset fast --frames 30
+./benchmark --check
+./benchmark --preset fast --check --baseline baseline-fast.txt
+make compare-me        (integer and float motion estimation, BMms and totalms give the throughput of each)
+make compare-quadtree  (fixed and variable block sizes, SADMpx and PSNR dB give the work saved and the quality kept)
+*/
@@ -0,0 +1,69 @@
+/*
+****************************************
+* This file contains the declaration
+* of the benchmark, which runs the BMC
+* algorithm on the synthetic clips and
+* scores the motion vectors it finds
+* against the true motion, together with
+* the time spent in every stage.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <opencv2/core.hpp>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include "../bmc.hpp"
+#include "../pool_allocator.hpp"
+#include "synthetic.hpp"
+
+using namespace cv;
+using namespace std;
+
+struct ClipScore
+{
+    int pairs;
+    double errorSum;         // end point error of the interior blocks, in pixels
+    double boundaryErrorSum; // end point error of the boundary blocks
+    size_t interiorBlocks, boundaryBlocks;
+    size_t within1, withinHalf; // interior blocks with an error of at most 1 and 0.5 pixels
+    double psnrSum;             // PSNR of the frame interpolated halfway, against the true frame at t + 0.5
+    size_t sadPixels;           // pixels compared by block matching, summed over the pairs
+    int globalPairs, globalFits; // pan pairs with a global motion model, and the pairs the model fitted
+    double globalErrorSum;       // error of the fitted motion of the frame center against the pan, in pixels
+    int steadyPairs;                // pairs after BENCHMARK_POOL_WARMUP with the pooling allocator installed
+    size_t steadySystemAllocations; // buffers those pairs could not take from the pool
+    StageTimes times;           // summed over the pairs
+    double totalMs;
+};
+
+// regression limits of a clip, read from the baseline file
+struct ClipLimits
+{
+    double maxEPE; // end point error of the interior blocks, in pixels
+    double maxMs;  // milliseconds per frame pair
+};
+
+void scorePair(const vector<vector<Point2f>> &found, const vector<vector<Point2f>> &trueMV, const vector<vector<BlockTruth>> &blockTruth, ClipScore &score);
+void runClip(const SyntheticClip &clip, const BlockMatchingCorrelation &settings, int numFrames, ClipScore &score);
+void writeScore(ostream &out, const String &name, const ClipScore &score);
+bool readBaseline(const String &fileName, map<String, ClipLimits> &limits);
+bool writeBaseline(const String &fileName, const vector<pair<String, ClipScore>> &scores);
+bool checkScore(ostream &out, const String &name, const ClipScore &score, const ClipLimits &limits);
+bool checkGlobalMotion(ostream &out, const String &name, const ClipScore &score);
+bool checkDedup(ostream &out, int numFrames);
+bool checkPool(ostream &out, const String &name, const ClipScore &score);
+
+#define BENCHMARK_FILE "benchmark.txt"
+#define BENCHMARK_FRAMES 12
+#define BENCHMARK_BASELINE "baseline.txt" // limits of the default settings, checked with --check
+#define BENCHMARK_EPE_MARGIN 0.1          // pixels added to the measured EPE by --update-baseline
+#define BENCHMARK_TIME_MARGIN 1.5         // the measured time is multiplied by this by --update-baseline
+#define BENCHMARK_GLOBAL_ERROR 0.5        // pixels the fitted global motion may differ from the pan of a clip
+#define BENCHMARK_POOL_WARMUP 2           // pairs of a clip that may allocate from the system with --pool
+
+#endif
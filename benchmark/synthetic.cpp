@@ -0,0 +1,127 @@
+/*
+****************************************
+* This file contains the definitions of
+* the synthetic motion generator.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include "synthetic.hpp"
+
+using namespace cv;
+using namespace std;
+
+static Mat randomTexture(Size size, unsigned seed)
+{
+    // smoothed noise has structure at every block size, so block matching has something to match
+    RNG rng(seed);
+    Mat noise(size, CV_8UC1), texture;
+    rng.fill(noise, RNG::UNIFORM, 0, 256);
+    GaussianBlur(noise, texture, Size(0, 0), 2.0);
+    normalize(texture, texture, 0, 255, NORM_MINMAX);
+    return texture;
+}
+
+static Mat translation(Point2f shift)
+{
+    return (Mat_<double>(2, 3) << 1, 0, shift.x, 0, 1, shift.y);
+}
+
+static int blockPos(int index, int length)
+{
+    // same block layout as divideIntoBlocks, the last row is aligned to the bottom of the frame
+    return min(index * BLOCK_SIZE, length - BLOCK_SIZE);
+}
+
+SyntheticClip::SyntheticClip(const String &name, Point2f backgroundVelocity, unsigned seed)
+    : backgroundVelocity(backgroundVelocity), name(name)
+{
+    background = randomTexture(Size(FRAME_WIDTH + 2 * SYNTHETIC_MARGIN, FRAME_HEIGHT + 2 * SYNTHETIC_MARGIN), seed);
+}
+
+void SyntheticClip::addObject(Point2f position, Point2f velocity, Size size, unsigned seed)
+{
+    Mat texture = randomTexture(size, seed);
+    // a different brightness so that the edges of the object are visible
+    texture.convertTo(texture, CV_8UC1, 0.5, 96);
+    objects.push_back({position, velocity, size, texture});
+}
+
+void SyntheticClip::frame(double t, UMat &frame) const
+{
+    /* frame t of the clip, the content moves by velocity * t with bilinear resampling for sub-pixel motion */
+    Size frameSize(FRAME_WIDTH, FRAME_HEIGHT);
+    Point2f margin(SYNTHETIC_MARGIN, SYNTHETIC_MARGIN);
+    Mat gray, layer, mask;
+
+    warpAffine(background, gray, translation(backgroundVelocity * (float)t - margin), frameSize, INTER_LINEAR, BORDER_REFLECT);
+    for (auto &object : objects)
+    {
+        Mat opaque(object.size, CV_8UC1, Scalar(255));
+        Point2f shift = object.position + object.velocity * (float)t;
+        warpAffine(object.texture, layer, translation(shift), frameSize, INTER_LINEAR, BORDER_CONSTANT);
+        warpAffine(opaque, mask, translation(shift), frameSize, INTER_NEAREST, BORDER_CONSTANT);
+        layer.copyTo(gray, mask);
+    }
+    Mat bgr;
+    cvtColor(gray, bgr, COLOR_GRAY2BGR);
+    bgr.copyTo(frame);
+}
+
+void SyntheticClip::truth(int t, vector<vector<Point2f>> &blockMV, vector<vector<BlockTruth>> &blockTruth) const
+{
+    /* true vectors of the blocks of frame t towards frame t + 1 */
+    blockMV.assign(NUM_BLOCKS_Y, vector<Point2f>(NUM_BLOCKS_X, backgroundVelocity));
+    blockTruth.assign(NUM_BLOCKS_Y, vector<BlockTruth>(NUM_BLOCKS_X, TRUTH_INTERIOR));
+
+    for (int i = 0; i < NUM_BLOCKS_Y; i++)
+    {
+        for (int j = 0; j < NUM_BLOCKS_X; j++)
+        {
+            Rect2f block((float)blockPos(j, FRAME_WIDTH), (float)blockPos(i, FRAME_HEIGHT), BLOCK_SIZE, BLOCK_SIZE);
+            // the objects drawn last are on top
+            for (int k = (int)objects.size() - 1; k >= 0; k--)
+            {
+                const MovingObject &object = objects[k];
+                Rect2f now(object.position + object.velocity * (float)t, Size2f(object.size));
+                Rect2f next(object.position + object.velocity * (float)(t + 1), Size2f(object.size));
+                Rect2f overlap = block & now;
+                if (overlap.area() >= block.area())
+                {
+                    blockMV[i][j] = object.velocity;
+                    break;
+                }
+                // an edge of the object, or background that the object covers in frame t + 1
+                if (overlap.area() > 0 || (block & next).area() > 0)
+                {
+                    blockTruth[i][j] = TRUTH_BOUNDARY;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void buildCorpus(vector<SyntheticClip> &clips)
+{
+    clips.clear();
+
+    clips.push_back(SyntheticClip("pan", Point2f(6, -3), 1));
+
+    clips.push_back(SyntheticClip("subpixel-pan", Point2f(2.5f, 1.25f), 2));
+
+    clips.push_back(SyntheticClip("large-pan", Point2f(24, 16), 3));
+
+    // still background with objects translating on their own
+    clips.push_back(SyntheticClip("regions", Point2f(0, 0), 4));
+    clips.back().addObject(Point2f(100, 100), Point2f(8, 0), Size(256, 192), 41);
+    clips.back().addObject(Point2f(700, 150), Point2f(-5, 4), Size(192, 192), 42);
+    clips.back().addObject(Point2f(1300, 120), Point2f(0, 10), Size(320, 160), 43);
+    clips.back().addObject(Point2f(200, 650), Point2f(6.5f, -2.5f), Size(256, 256), 44);
+    clips.back().addObject(Point2f(1100, 700), Point2f(-12, -3), Size(288, 224), 45);
+
+    // panning background crossed by two large objects
+    clips.push_back(SyntheticClip("occluders", Point2f(4, 0), 5));
+    clips.back().addObject(Point2f(1400, 200), Point2f(-14, 2), Size(384, 384), 51);
+    clips.back().addObject(Point2f(200, 500), Point2f(10, -5), Size(448, 320), 52);
+}
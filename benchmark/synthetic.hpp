@@ -0,0 +1,63 @@
+/*
+****************************************
+* This file contains the declaration
+* of the synthetic motion generator.
+* Frames are built in memory from a
+* random texture with known motion :
+* global pans, sub-pixel shifts and
+* textured objects that move on their
+* own and occlude the background. The
+* true motion vector of every block is
+* known, so the vectors found by the
+* BMC algorithm can be scored.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef SYNTHETIC_HPP
+#define SYNTHETIC_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include "../constants.hpp"
+
+using namespace cv;
+using namespace std;
+
+#define SYNTHETIC_MARGIN 512 // pixels of texture around the frame, the largest pan of a clip
+
+struct MovingObject
+{
+    Point2f position; // top left corner in frame 0
+    Point2f velocity; // pixels per frame
+    Size size;
+    Mat texture;
+};
+
+// how the true vector of a block is known
+enum BlockTruth
+{
+    TRUTH_INTERIOR, // the block lies on the background or inside one object
+    TRUTH_BOUNDARY  // the block covers an object edge, or a region that is covered or uncovered
+};
+
+class SyntheticClip
+{
+    Mat background;
+    Point2f backgroundVelocity;
+    vector<MovingObject> objects;
+
+public:
+    String name;
+
+    SyntheticClip(const String &name, Point2f backgroundVelocity, unsigned seed);
+    void addObject(Point2f position, Point2f velocity, Size size, unsigned seed);
+    void frame(double t, UMat &frame) const; // t may lie between two frames, for the true interpolated frame
+    void truth(int t, vector<vector<Point2f>> &blockMV, vector<vector<BlockTruth>> &blockTruth) const;
+    bool isPan() const { return objects.empty(); } // the whole frame moves by getPan() per frame
+    Point2f getPan() const { return backgroundVelocity; }
+};
+
+void buildCorpus(vector<SyntheticClip> &clips);
+
+#endif
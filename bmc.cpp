@@ -16,6 +16,10 @@
 #include "constants.hpp"
 #include "util.hpp"
 #include "motion_compensation.hpp"
+#include "tiling.hpp"
+#include "checkpoint.hpp"
+#include "full_search.hpp"
+#include "metrics.hpp"
 
 using namespace cv;
 using namespace std;
@@ -66,149 +70,431 @@ void BlockMatchingCorrelation::divideIntoBlocks(const UMat &inpFrame, vector<vec
     }
 }
 
+void BlockMatchingCorrelation::regionCandidates(int i, int j, vector<Point2f> &candidates) const
+{
+    // obtain the motion vectors of the global region that block (i, j) lies in
+    int rowGR = i / ((int)(GR_WIDTH / BLOCK_SIZE));
+    int colGR = j / ((int)(GR_HEIGHT / BLOCK_SIZE));
+    if (rowGR > NUM_GR_Y - 1)
+        rowGR = NUM_GR_Y - 1;
+    if (colGR > NUM_GR_X - 1)
+        colGR = NUM_GR_X - 1;
+    for (auto point : globalRegionMV[rowGR][colGR])
+        candidates.push_back(point);
+
+    // obtain the motion vectors of the local region that this block lies in
+    int rowLR = i / ((int)(LR_WIDTH / BLOCK_SIZE));
+    int colLR = j / ((int)(LR_HEIGHT / BLOCK_SIZE));
+    if (rowLR > NUM_LR_Y - 1)
+        rowLR = NUM_LR_Y - 1;
+    if (colLR > NUM_LR_X - 1)
+        colLR = NUM_LR_X - 1;
+    for (auto point : localRegionMV[rowLR][colLR])
+        candidates.push_back(point);
+}
+
+void BlockMatchingCorrelation::fitGlobalMotion()
+{
+    /* fits globalModel to the best vector of every global and local region, each vector
+       moves the center of its region (the regions are laid out as in divideIntoGlobal and divideIntoLocal) */
+    vector<Point2f> src, dst;
+    double inlierRatio;
+    // the vectors were found on the regions resized to stdSize, they are scaled back to frame pixels
+    Point2f globalScale((float)GR_WIDTH / STANDARD_REGION_WIDTH, (float)GR_HEIGHT / STANDARD_REGION_HEIGHT);
+    Point2f localScale((float)LR_WIDTH / STANDARD_REGION_WIDTH, (float)LR_HEIGHT / STANDARD_REGION_HEIGHT);
+    for (int r = 0; r < NUM_GR_Y; r++)
+    {
+        for (int c = 0; c < NUM_GR_X; c++)
+        {
+            Point2f center(c * (FRAME_WIDTH - GR_WIDTH) + GR_WIDTH / 2, r * (FRAME_HEIGHT - GR_HEIGHT) + GR_HEIGHT / 2);
+            Point2f mv = globalRegionMV[r][c][0];
+            src.push_back(center);
+            dst.push_back(center + Point2f(mv.x * globalScale.x, mv.y * globalScale.y));
+        }
+    }
+    for (int r = 0; r < NUM_LR_Y; r++)
+    {
+        for (int c = 0; c < NUM_LR_X; c++)
+        {
+            Point2f center(min(c * LR_WIDTH, FRAME_WIDTH - LR_WIDTH) + LR_WIDTH / 2, min(r * LR_HEIGHT, FRAME_HEIGHT - LR_HEIGHT) + LR_HEIGHT / 2);
+            Point2f mv = localRegionMV[r][c][0];
+            src.push_back(center);
+            dst.push_back(center + Point2f(mv.x * localScale.x, mv.y * localScale.y));
+        }
+    }
+    globalFit = fitGlobalModel(src, dst, globalModel, globalH, inlierRatio);
+    globalStats.pairs++;
+    if (globalFit)
+        globalStats.fitted++;
+    if (verbose)
+        cout << "global motion " << (globalFit ? "fits " : "rejected ") << 100.0 * inlierRatio << "% inliers ";
+}
+
 void BlockMatchingCorrelation::blockMatching(const UMat &prev, const UMat &curr)
 {
     // finds the motion vector for a block
-    vector<vector<UMat>> prevBlocks(NUM_BLOCKS_Y, vector<UMat>(NUM_BLOCKS_X));
+    vector<vector<UMat>> prevBlocks;
     UMat prev32f, curr32f;
-    vector<Point2f> motionVectorCandidates(7, Point2f(0, 0)); // stores the seven possible MVC
-    int rowGR, colGR, rowLR, colLR;
-    float SAD, minSAD;
-
-    divideIntoBlocks(prev, prevBlocks);
-    curr.convertTo(curr32f, CV_32FC1);
+    Mat prevInt, currInt;
+    Mat prevIntegral, currIntegral;        // for the full-search refinement
+    vector<Point2f> motionVectorCandidates; // stores the 2 * numPeaks + 3 possible MVC
+    vector<vector<char>> merged;             // blocks covered by a 64x64 quadtree node
+    vector<vector<char>> global;             // blocks that follow the global motion model
+    int SAD, minSAD;
+
+    levelScale = pixelLevelScale(prev.depth());
+    if (integerME)
+    {
+        // the 8 or 16-bit luma is read in place, no float copy of the frame is made
+        prevInt = prev.getMat(ACCESS_READ);
+        currInt = curr.getMat(ACCESS_READ);
+        if (searchRange > 0)
+        {
+            // 16-bit sums of a whole frame do not fit in 32 bits
+            int sumDepth = prevInt.depth() == CV_16U ? CV_64F : CV_32S;
+            integral(prevInt, prevIntegral, sumDepth);
+            integral(currInt, currIntegral, sumDepth);
+        }
+    }
+    else
+    {
+        prevBlocks.assign(NUM_BLOCKS_Y, vector<UMat>(NUM_BLOCKS_X));
+        divideIntoBlocks(prev, prevBlocks);
+        curr.convertTo(curr32f, CV_32FC1);
+    }
+    motionVectorCandidates.reserve(2 * numPeaks + 3);
+    partition.clear();
+    globalFit = false;
+    if (globalModel != GLOBAL_OFF && integerME)
+        fitGlobalMotion();
+    if (globalFit)
+    {
+        // a block whose model vector matches is not searched, the others are the outlier regions
+        int followers = 0;
+        global.assign(NUM_BLOCKS_Y, vector<char>(NUM_BLOCKS_X, 0));
+        for (int i = 0; i < NUM_BLOCKS_Y; i++)
+        {
+            for (int j = 0; j < NUM_BLOCKS_X; j++)
+            {
+                Point pos(j * BLOCK_SIZE, min(i * BLOCK_SIZE, prevInt.rows - BLOCK_SIZE));
+                Point2f v = globalVector(globalH, Point2f(pos) + Point2f(BLOCK_SIZE / 2, BLOCK_SIZE / 2));
+                Point d((int)round(v.x), (int)round(v.y));
+                int SAD = regionSADInt(prevInt, currInt, Rect(pos, Size(BLOCK_SIZE, BLOCK_SIZE)), d, INT_MAX);
+                sadPixels += BLOCK_SIZE * BLOCK_SIZE;
+                if (SAD > GLOBAL_MOTION_SAD * levelScale * BLOCK_SIZE * BLOCK_SIZE)
+                    continue;
+                global[i][j] = 1;
+                currBlockMV[i][j] = Point2f((float)d.x, (float)d.y);
+                blockSAD[i][j] = SAD;
+                followers++;
+            }
+        }
+        globalStats.blocks += followers;
+        globalStats.outliers += NUM_BLOCKS_Y * NUM_BLOCKS_X - followers;
+    }
+    else if (quadtree && integerME)
+        mergeBlocks(prevInt, currInt, merged);
 
     for (int i = 0; i < NUM_BLOCKS_Y; i++)
     {
         for (int j = 0; j < NUM_BLOCKS_X; j++)
         {
-            // obtain the motion vectors of the global region that this block lies in
-            rowGR = i / ((int)(GR_WIDTH / BLOCK_SIZE));
-            colGR = j / ((int)(GR_HEIGHT / BLOCK_SIZE));
-            if (rowGR > NUM_GR_Y - 1)
-                rowGR = NUM_GR_Y - 1;
-            if (colGR > NUM_GR_X - 1)
-                colGR = NUM_GR_X - 1;
-            motionVectorCandidates[0] = globalRegionMV[rowGR][colGR][0];
-            motionVectorCandidates[1] = globalRegionMV[rowGR][colGR][1];
-
-            // obtain the motion vectors of the local region that this block lies in
-            rowLR = i / ((int)(LR_WIDTH / BLOCK_SIZE));
-            colLR = j / ((int)(LR_HEIGHT / BLOCK_SIZE));
-            if (rowLR > NUM_LR_Y - 1)
-                rowLR = NUM_LR_Y - 1;
-            if (colLR > NUM_LR_X - 1)
-                colLR = NUM_LR_X - 1;
-            motionVectorCandidates[2] = localRegionMV[rowLR][colLR][0];
-            motionVectorCandidates[3] = localRegionMV[rowLR][colLR][1];
+            // blocks of a merged quadtree node already have their vector
+            if (!merged.empty() && merged[i][j])
+                continue;
+            if (!global.empty() && global[i][j])
+                continue;
+            motionVectorCandidates.clear();
+            regionCandidates(i, j, motionVectorCandidates);
 
             // obtain the motion vector of the immediate LEFT neighbor
             // also, add a small random value (noise) to the motion vector of the immediate LEFT neighbor
             if (i - 1 < 0)
             {
-                motionVectorCandidates[4] = Point2f(0, 0);
-                motionVectorCandidates[5] = Point2f((float)rand() / RAND_MAX, (float)rand() / RAND_MAX); // random number between 0 and 1
+                motionVectorCandidates.push_back(Point2f(0, 0));
+                motionVectorCandidates.push_back(Point2f(rng.uniform(0.f, 1.f), rng.uniform(0.f, 1.f))); // random number between 0 and 1
             }
             else
             {
-                motionVectorCandidates[4] = currBlockMV[i - 1][j];
-                motionVectorCandidates[5] = Point2f(currBlockMV[i - 1][j].x + (float)rand() / RAND_MAX, currBlockMV[i - 1][j].y + (float)rand() / RAND_MAX);
+                motionVectorCandidates.push_back(currBlockMV[i - 1][j]);
+                motionVectorCandidates.push_back(Point2f(currBlockMV[i - 1][j].x + rng.uniform(0.f, 1.f), currBlockMV[i - 1][j].y + rng.uniform(0.f, 1.f)));
             }
 
             // find the median of neighboring candidates from the previous MVF, i.e, MVF(n-1)
-            motionVectorCandidates[6] = medianNeighbor(i, j, prevBlockMV);
+            motionVectorCandidates.push_back(medianNeighbor(i, j, prevBlockMV));
+
+            if (preset.maxCandidates > 0 && (int)motionVectorCandidates.size() > preset.maxCandidates)
+            {
+                // keep the most reliable candidates : the median of MVF(n-1), the neighbor,
+                // the best local and global peaks, then the remaining peaks
+                vector<Point2f> ordered = {motionVectorCandidates[2 * numPeaks + 2], motionVectorCandidates[2 * numPeaks],
+                                           motionVectorCandidates[numPeaks], motionVectorCandidates[0]};
+                for (int k = 1; k < numPeaks; k++)
+                {
+                    ordered.push_back(motionVectorCandidates[numPeaks + k]);
+                    ordered.push_back(motionVectorCandidates[k]);
+                }
+                ordered.push_back(motionVectorCandidates[2 * numPeaks + 1]);
+                ordered.resize(preset.maxCandidates);
+                motionVectorCandidates = ordered;
+            }
 
             // find minimum SAD and winning motion vector
-            prevBlocks[i][j].convertTo(prev32f, CV_32FC1);
-            minSAD = (float)INT_MAX;
+            // candidates are rounded once, a displacement already scored for this block comes from the cache
+            Mat prevBlock;
+            if (integerME)
+                prevBlock = getPaddedROI(prevInt, j * BLOCK_SIZE, min(i * BLOCK_SIZE, prevInt.rows - BLOCK_SIZE), BLOCK_SIZE, BLOCK_SIZE); // same block as divideIntoBlocks
+            else
+                prevBlocks[i][j].convertTo(prev32f, CV_32FC1);
+            sadCache.clear();
+            minSAD = INT_MAX;
             for (auto point : motionVectorCandidates)
             {
-                SAD = calcSAD(prev32f, i, j, curr32f, point.x, point.y);
+                Point d((int)round(point.x), (int)round(point.y));
+                if (!sadCache.lookup(d, SAD))
+                {
+                    // with partialSAD a candidate stops being scored once it cannot beat minSAD
+                    int limit = preset.partialSAD ? minSAD : INT_MAX;
+                    if (integerME)
+                        SAD = calcSADInt(prevBlock, i, j, currInt, d.x, d.y, limit);
+                    else
+                        SAD = calcSAD(prev32f, i, j, curr32f, (float)d.x, (float)d.y);
+                    sadCache.insert(d, SAD);
+                    sadPixels += BLOCK_SIZE * BLOCK_SIZE;
+                }
                 if (SAD < minSAD)
                 {
                     minSAD = SAD;
-                    currBlockMV[i][j].x = point.x;
-                    currBlockMV[i][j].y = point.y;
+                    currBlockMV[i][j].x = (float)d.x;
+                    currBlockMV[i][j].y = (float)d.y;
                 }
+                // the match is good enough, the remaining candidates are not scored
+                if (minSAD <= preset.earlyExitSAD * levelScale * BLOCK_SIZE * BLOCK_SIZE)
+                    break;
+            }
+            blockSAD[i][j] = minSAD;
+
+            // a block that did not match well enough searches the window around its best candidate
+            if (searchRange > 0 && integerME && minSAD > preset.earlyExitSAD * levelScale * BLOCK_SIZE * BLOCK_SIZE)
+            {
+                Point pos(j * BLOCK_SIZE, min(i * BLOCK_SIZE, prevInt.rows - BLOCK_SIZE));
+                Point best((int)currBlockMV[i][j].x, (int)currBlockMV[i][j].y);
+                int bestSAD = minSAD;
+                size_t evaluated = searchStats.positions - searchStats.pruned;
+                fullSearch(prevBlock, integralSum(prevIntegral, Rect(pos, prevBlock.size())), pos, currInt, currIntegral,
+                           searchRange, best, bestSAD, searchStats);
+                sadPixels += (searchStats.positions - searchStats.pruned - evaluated) * BLOCK_SIZE * BLOCK_SIZE;
+                currBlockMV[i][j] = Point2f((float)best.x, (float)best.y);
+                blockSAD[i][j] = bestSAD;
+            }
+        }
+    }
+    // blocks that matched badly are split into smaller quadtree nodes
+    if (quadtree && integerME)
+    {
+        splitBlocks(prevInt, currInt, merged, global);
+    }
+    else if (globalFit)
+    {
+        // the outlier blocks are compensated on top of the warped frame
+        for (int i = 0; i < NUM_BLOCKS_Y; i++)
+        {
+            for (int j = 0; j < NUM_BLOCKS_X; j++)
+            {
+                if (global[i][j])
+                    continue;
+                QTBlock block;
+                block.rect = Rect(j * BLOCK_SIZE, min(i * BLOCK_SIZE, prevInt.rows - BLOCK_SIZE), BLOCK_SIZE, BLOCK_SIZE);
+                block.mv = currBlockMV[i][j];
+                block.SAD = blockSAD[i][j];
+                partition.push_back(block);
             }
         }
     }
+    matchedPairs++;
+
     // the motion vectors of all blocks have been found
     prevBlockMV = currBlockMV;
     currBlockMV = zeroes;
 }
 
+void BlockMatchingCorrelation::printMatchingSummary() const
+{
+    if (matchedPairs == 0)
+        return;
+    cout << "Block matching : " << sadPixels / 1e6 / matchedPairs << " Mpixels of SAD per frame pair" << endl;
+    if (globalStats.pairs > 0)
+        cout << "Global motion : the model fits " << globalStats.fitted << " of " << globalStats.pairs << " frame pairs, "
+             << globalStats.blocks << " blocks warped and " << globalStats.outliers << " outlier blocks matched" << endl;
+    if (searchStats.blocks > 0)
+        cout << "Full search : " << searchStats.pruned << " of " << searchStats.positions << " positions pruned ("
+             << 100.0 * searchStats.pruned / max<size_t>(1, searchStats.positions) << "%), "
+             << (double)(searchStats.positions - searchStats.pruned) / searchStats.blocks << " SADs and "
+             << 1000.0 * searchStats.ms / searchStats.blocks << " us per block, "
+             << searchStats.improved << " of " << searchStats.blocks << " blocks improved" << endl;
+    if (quadtree && !integerME)
+        cout << "The quadtree needs the integer luma, the float path matched the fixed grid" << endl;
+    if (!quadtree || !integerME)
+        return;
+    cout << "Quadtree blocks per frame pair :";
+    for (int level = 0; level < QUADTREE_LEVELS; level++)
+    {
+        int size = QUADTREE_MAX_BLOCK >> level;
+        cout << " " << size << "x" << size << " " << (double)quadtreeBlocks[level] / matchedPairs;
+    }
+    cout << endl;
+}
+
+void BlockMatchingCorrelation::standardRegion(const UMat &region, UMat &region32f)
+{
+    // resizes a region to stdSize, with integerME only the resized region is converted to float
+    if (integerME)
+    {
+        UMat region8u;
+        resize(region, region8u, stdSize);
+        region8u.convertTo(region32f, CV_32FC1);
+    }
+    else
+    {
+        region.convertTo(region32f, CV_32FC1);
+        resize(region32f, region32f, stdSize);
+    }
+}
+
 void BlockMatchingCorrelation::customisedPhaseCorr(const UMat &prev, const UMat &curr)
 {
     vector<UMat> prevRegions(NUM_GR_Y * NUM_GR_X), currRegions(NUM_GR_Y * NUM_GR_X);
-    vector<Point2f> motionVectorCandidates;
+    vector<UMat> prevLocalRegions(NUM_LR_Y * NUM_LR_X), currLocalRegions(NUM_LR_Y * NUM_LR_X);
+    vector<bool> refreshed(NUM_CPPC_REGIONS, false);
     UMat prev32f, curr32f;
-    int num;
     UMat diff;
-    // calculate PPC for each global region
-    divideIntoGlobal(prev, prevRegions);
-    divideIntoGlobal(curr, currRegions);
-    num = 0;
+    CPPCMode mode = cppcScheduler.beginPair();
 
-    for (int i = 0; i < NUM_GR_Y; i++) // rows
+    stageTimes.globalCPPC = stageTimes.localCPPC = 0;
+    if (mode != CPPC_SKIP)
     {
-        for (int j = 0; j < NUM_GR_X; j++) //columns
+        divideIntoGlobal(prev, prevRegions);
+        divideIntoGlobal(curr, currRegions);
+        if (localCPPC)
         {
-            prevRegions[num].convertTo(prev32f, CV_32FC1);
-            currRegions[num].convertTo(curr32f, CV_32FC1);
-            resize(prev32f, prev32f, stdSize);
-            resize(curr32f, curr32f, stdSize);
-            motionVectorCandidates = phaseCorr(prev32f, curr32f, noArray(), 0);
-            globalRegionMV[i][j] = motionVectorCandidates;
-            /* This is the same as :
-	            globalRegionMV[i][j][0] = motionVectorCandidates[0];
-	            globalRegionMV[i][j][1] = motionVectorCandidates[1];
-	            */
-            num++;
+            divideIntoLocal(prev, prevLocalRegions);
+            divideIntoLocal(curr, currLocalRegions);
         }
     }
 
-    // calculate PPC for each local region
-    prevRegions.resize(NUM_LR_Y * NUM_LR_X);
-    currRegions.resize(NUM_LR_Y * NUM_LR_X);
-    divideIntoLocal(prev, prevRegions);
-    divideIntoLocal(curr, currRegions);
-    num = 0;
-    for (int i = 0; i < NUM_LR_Y; i++) // rows
+    // calculate PPC for a global region
+    auto correlateGlobal = [&](int i, int j) {
+        Point2f lastMV = globalRegionMV[i][j][0];
+        standardRegion(prevRegions[i * NUM_GR_X + j], prev32f);
+        standardRegion(currRegions[i * NUM_GR_X + j], curr32f);
+        globalRegionMV[i][j] = phaseCorr(prev32f, curr32f, noArray(), &globalRegionResponse[i][j], numPeaks);
+        cppcScheduler.observe(lastMV, globalRegionMV[i][j][0], globalRegionResponse[i][j]);
+    };
+
+    // calculate PPC for a local region
+    auto correlateLocal = [&](int i, int j) {
+        Point2f lastMV = localRegionMV[i][j][0];
+        standardRegion(prevLocalRegions[i * NUM_LR_X + j], prev32f);
+        standardRegion(currLocalRegions[i * NUM_LR_X + j], curr32f);
+
+        absdiff(prev32f, curr32f, diff);
+        if (countNonZero(diff) == 0) // both regions are equal
+        {
+            localRegionMV[i][j].assign(numPeaks, Point2f(0, 0));
+            localRegionResponse[i][j] = 1.0;
+        }
+        else
+        {
+            localRegionMV[i][j] = phaseCorr(prev32f, curr32f, noArray(), &localRegionResponse[i][j], numPeaks);
+        }
+        cppcScheduler.observe(lastMV, localRegionMV[i][j][0], localRegionResponse[i][j]);
+    };
+
+    // the second pass only runs when a rotating refresh finds that the regions moved or lost confidence,
+    // it correlates the regions that the first pass left out
+    for (int pass = 0; pass < 2; pass++)
     {
-        for (int j = 0; j < NUM_LR_X; j++) //columns
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < NUM_GR_Y; i++) // rows
         {
-            prevRegions[num].convertTo(prev32f, CV_32FC1);
-            currRegions[num].convertTo(curr32f, CV_32FC1);
-            resize(prev32f, prev32f, stdSize);
-            resize(curr32f, curr32f, stdSize);
+            for (int j = 0; j < NUM_GR_X; j++) //columns
+            {
+                int r = i * NUM_GR_X + j;
+                if (refreshed[r] || !cppcScheduler.refresh(r))
+                    continue;
+                correlateGlobal(i, j);
+                refreshed[r] = true;
+            }
+        }
+        stageTimes.globalCPPC += msSince(start);
 
-            absdiff(prev32f, curr32f, diff);
-            if (countNonZero(diff) == 0) // both regions are equal
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < NUM_LR_Y && localCPPC; i++) // rows
+        {
+            for (int j = 0; j < NUM_LR_X; j++) //columns
             {
-                localRegionMV[i][j][0] = Point2f(0, 0);
-                localRegionMV[i][j][1] = Point2f(0, 0);
+                int r = NUM_GR_Y * NUM_GR_X + i * NUM_LR_X + j;
+                // faster presets only correlate every localRegionStep-th region
+                if ((i + j) % preset.localRegionStep != 0 || refreshed[r] || !cppcScheduler.refresh(r))
+                    continue;
+                correlateLocal(i, j);
+                refreshed[r] = true;
             }
-            else
+        }
+        stageTimes.localCPPC += msSince(start);
+
+        if (mode != CPPC_ROTATING || !cppcScheduler.confidenceDropped())
+            break;
+        cppcScheduler.upgradeToFull();
+        mode = CPPC_FULL;
+    }
+
+    // count the correlations that the scheduler saved
+    for (int r = 0; r < NUM_CPPC_REGIONS; r++)
+    {
+        int k = r - NUM_GR_Y * NUM_GR_X;
+        if (k >= 0 && (!localCPPC || (k / NUM_LR_X + k % NUM_LR_X) % preset.localRegionStep != 0))
+            continue;
+        cppcScheduler.dueRegions++;
+        if (!refreshed[r])
+            cppcScheduler.savedRegions++;
+    }
+    if (verbose && mode != CPPC_FULL)
+        cout << (mode == CPPC_SKIP ? "(vectors reused) " : "(rotating refresh) ");
+    if (!localCPPC || mode == CPPC_SKIP)
+        return;
+
+    // the skipped local regions take the vectors of the nearest correlated region in their row
+    auto start = chrono::steady_clock::now();
+    if (preset.localRegionStep > 1)
+    {
+        for (int i = 0; i < NUM_LR_Y; i++)
+        {
+            for (int j = 0; j < NUM_LR_X; j++)
             {
-                motionVectorCandidates = phaseCorr(prev32f, curr32f, noArray(), 0);
-                localRegionMV[i][j] = motionVectorCandidates;
-                /* This is the same as :
-	            localRegionMV[i][j][0] = motionVectorCandidates[0];
-	            localRegionMV[i][j][1] = motionVectorCandidates[1];
-	            */
+                if ((i + j) % preset.localRegionStep == 0)
+                    continue;
+                for (int d = 1; d < NUM_LR_X; d++)
+                {
+                    int k = (j - d >= 0 && (i + j - d) % preset.localRegionStep == 0) ? j - d : j + d;
+                    if (k < NUM_LR_X && (i + k) % preset.localRegionStep == 0)
+                    {
+                        localRegionMV[i][j] = localRegionMV[i][k];
+                        localRegionResponse[i][j] = localRegionResponse[i][k];
+                        break;
+                    }
+                }
             }
-            num++;
         }
     }
+    stageTimes.localCPPC += msSince(start);
 }
 
-void BlockMatchingCorrelation::BMC(const UMat &prev, const UMat &curr, UMat &interpolatedFrame)
+void BlockMatchingCorrelation::motionEstimation(const UMat &prev, const UMat &curr)
 {
     /* this algorithm determines the motion vector for each block */
     UMat f1, f2, lumI1, lumI2;
     vector<UMat> lum1, lum2;
-    vector<vector<UMat>> prevBlocks(NUM_BLOCKS_Y, vector<UMat>(NUM_BLOCKS_X));
 
     cvtColor(prev, f1, COLOR_BGR2YCrCb);
     cvtColor(curr, f2, COLOR_BGR2YCrCb);
@@ -221,34 +507,315 @@ void BlockMatchingCorrelation::BMC(const UMat &prev, const UMat &curr, UMat &int
     lumI2 = lum2[0];
 
     /*---------- Customised Phase Plane Correlation (CPPC) ---------*/
-    cout << " Beginning CPPC : ";
+    if (verbose)
+        cout << " Beginning CPPC : ";
+    getPoolAllocator().setStage(STAGE_CPPC);
+    getPerfCounters().begin(STAGE_CPPC);
     customisedPhaseCorr(lumI1, lumI2);
+    getPerfCounters().end(STAGE_CPPC);
 
     /*---------- Block Matching ----------*/
-    cout << "Beginning BM : ";
+    if (verbose)
+        cout << "Beginning BM : ";
+    getPoolAllocator().setStage(STAGE_BM);
+    size_t hits = sadCache.hits, lookups = sadCache.lookups;
+    auto start = chrono::steady_clock::now();
+    getPerfCounters().begin(STAGE_BM);
     blockMatching(lumI1, lumI2);
+    getPerfCounters().end(STAGE_BM);
+    stageTimes.BM = msSince(start);
+    getPoolAllocator().setStage(STAGE_OTHER);
+
+    // the mean block SAD tells the CPPC scheduler whether the reused region vectors still fit
+    double meanSAD = 0;
+    for (auto &row : blockSAD)
+        for (auto SAD : row)
+            meanSAD += SAD;
+    cppcScheduler.endPair(meanSAD / (NUM_BLOCKS_Y * NUM_BLOCKS_X));
+    if (verbose)
+        cout << "SAD cache hit rate " << 100.0 * (sadCache.hits - hits) / max<size_t>(1, sadCache.lookups - lookups) << "% ";
+}
 
-    /*---------- Frame interpolation ----------*/
-    divideIntoBlocks(prev, prevBlocks);
+void BlockMatchingCorrelation::motionCompensation(const UMat &prev, const UMat &curr, UMat &interpolatedFrame, double t)
+{
+    /* builds the frame at time t (0 < t < 1) between prev and curr from prevBlockMV,
+       from the quadtree partition when the blocks have variable sizes,
+       or by warping the frame with the global motion model and compensating its outlier blocks */
+    getPoolAllocator().setStage(STAGE_MC);
+    {
+        auto start = chrono::steady_clock::now();
+        getPerfCounters().begin(STAGE_MC);
 
-    cout << "Frame interpolation : ";
-    bidirectionalMotionCompensation(prevBlocks, curr, prevBlockMV, interpolatedFrame);
-    cout << "Interpolation complete\n";
+        if (verbose)
+            cout << "Frame interpolation : ";
+        if (globalFit)
+        {
+            globalMotionCompensation(prev, curr, globalH, partition, interpolatedFrame, t);
+        }
+        else if (partition.empty())
+        {
+            bidirectionalMotionCompensation(prev, curr, prevBlockMV, interpolatedFrame, t);
+        }
+        else
+        {
+            variableMotionCompensation(prev, curr, partition, interpolatedFrame, t);
+        }
+        getPerfCounters().end(STAGE_MC);
+        stageTimes.MC = msSince(start);
+        if (verbose)
+            cout << "Interpolation complete\n";
+    } // the block copies are released inside the MC stage
+    getPoolAllocator().setStage(STAGE_OTHER);
+}
+
+void BlockMatchingCorrelation::BMC(const UMat &prev, const UMat &curr, UMat &interpolatedFrame)
+{
+    motionEstimation(prev, curr);
+    motionCompensation(prev, curr, interpolatedFrame);
+}
+
+void BlockMatchingCorrelation::getMVField(MVField &field) const
+{
+    field.blockMV = prevBlockMV;
+    field.blockSAD = blockSAD;
+    field.globalRegionMV = globalRegionMV;
+    field.globalRegionResponse = globalRegionResponse;
+    field.localRegionMV = localRegionMV;
+    field.localRegionResponse = localRegionResponse;
+}
+
+void BlockMatchingCorrelation::setMVField(const MVField &field)
+{
+    partition.clear(); // the sidecar only has the fixed grid
+    globalFit = false;
+    prevBlockMV = field.blockMV;
+    blockSAD = field.blockSAD;
+    globalRegionMV = field.globalRegionMV;
+    globalRegionResponse = field.globalRegionResponse;
+    localRegionMV = field.localRegionMV;
+    localRegionResponse = field.localRegionResponse;
+}
+
+void BlockMatchingCorrelation::copySettings(const BlockMatchingCorrelation &other)
+{
+    rateFactor = other.rateFactor;
+    integerME = other.integerME;
+    preset = other.preset;
+    quadtree = other.quadtree;
+    searchRange = other.searchRange;
+    globalModel = other.globalModel;
+    dedup = other.dedup;
+    cppcScheduler.setEnabled(other.cppcScheduler.isEnabled());
+    setNumPeaks(other.numPeaks);
+}
+
+void BlockMatchingCorrelation::setNumPeaks(int peaks)
+{
+    numPeaks = peaks;
+    for (auto &row : globalRegionMV)
+        for (auto &regionMV : row)
+            regionMV.assign(numPeaks, Point2f(0, 0));
+    for (auto &row : localRegionMV)
+        for (auto &regionMV : row)
+            regionMV.assign(numPeaks, Point2f(0, 0));
+}
+
+bool BlockMatchingCorrelation::getFrameRange(int &first, int &last) const
+{
+    /* the span set by setFrameRange, last is -1 for the end of the video */
+    double fps = rangeStart.empty() && rangeEnd.empty() ? 0 : getInputFPS(inputVideo);
+    first = rangeStart.empty() ? 0 : parseFramePosition(rangeStart, fps);
+    last = rangeEnd.empty() ? -1 : parseFramePosition(rangeEnd, fps);
+    if (first < 0 || (!rangeEnd.empty() && last <= first))
+    {
+        cout << "Invalid frame range " << (rangeStart.empty() ? "0" : rangeStart) << " to " << (rangeEnd.empty() ? "end" : rangeEnd) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool BlockMatchingCorrelation::renderFromVectors(const String &mvFile)
+{
+    return mvReader.open(mvFile);
 }
 
 void BlockMatchingCorrelation::interpolate()
 {
+    Size inputSize = getInputSize(inputVideo);
+    if (needsTiling(inputSize))
+    {
+        // larger inputs are processed at full resolution, split into tiles of the engine's frame size
+        if (checkpointInterval > 0)
+            cout << "Checkpoints are not supported for inputs larger than " << FRAME_WIDTH << "x" << FRAME_HEIGHT << ", they are ignored" << endl;
+        TiledInterpolator tiled(*this);
+        tiled.interpolate(inputVideo);
+        return;
+    }
+
     vector<UMat> newFrames;
     UMat interpolatedFrame;
-    float newFPS = 2.0 * getInputFPS(inputVideo);
-    readFrames(inputVideo, frames); // vector of all frames in the video
+    MVField field;
+    bool fromVectors = mvReader.isOpen();
+    float newFPS = rateFactor * getInputFPS(inputVideo);
+    int firstFrame, lastFrame;
+    if (!getFrameRange(firstFrame, lastFrame))
+        exit(-1);
+
+    CheckpointHeader checkpoint;
+    bool resumed = false;
+    if (checkpointInterval > 0 && isImageSequence(inputVideo))
+    {
+        cout << "Checkpoints are not supported for image sequences, they are ignored" << endl;
+        checkpointInterval = 0;
+    }
+    if (checkpointInterval > 0)
+    {
+        if (!mvOutputFile.empty())
+        {
+            cout << "--save-mv cannot be combined with checkpoints, the vector file could not be resumed" << endl;
+            exit(-1);
+        }
+        // a checkpoint is only used for the same input and settings, otherwise the job starts over
+        if (resume && loadCheckpoint(CHECKPOINT_FILE, checkpoint, field) && String(checkpoint.input) == inputVideo &&
+            (int)checkpoint.rateFactor == rateFactor && (int)checkpoint.numPeaks == numPeaks)
+        {
+            firstFrame = (int)checkpoint.nextFrame;
+            lastFrame = (int)checkpoint.lastFrame;
+            setMVField(field);
+            resumed = true;
+            cout << "Resuming from frame " << firstFrame << " after " << checkpoint.segments << " segments" << endl;
+        }
+        else
+        {
+            memset(&checkpoint, 0, sizeof(checkpoint));
+            memcpy(checkpoint.magic, CHECKPOINT_MAGIC, sizeof(checkpoint.magic));
+            checkpoint.version = CHECKPOINT_VERSION;
+            checkpoint.rateFactor = rateFactor;
+            checkpoint.numPeaks = numPeaks;
+            checkpoint.nextFrame = firstFrame;
+            checkpoint.lastFrame = lastFrame;
+            strncpy(checkpoint.input, inputVideo.c_str(), sizeof(checkpoint.input) - 1);
+        }
+    }
+
+    // a few pairs before the span are estimated first so that its first pair has a previous MV field,
+    // a resumed job has the field of its checkpoint
+    int warmFirst = fromVectors || resumed ? firstFrame : max(0, firstFrame - SEGMENT_WARMUP);
+    int warmPairs = firstFrame - warmFirst;
+    // the frames are decoded one pair at a time, only the frames of the current pair are held
+    FrameStream stream;
+    UMat prevFrame, currFrame;
+    if (!stream.open(inputVideo, warmFirst, lastFrame) || !stream.read(prevFrame))
+        prevFrame.release();
+    for (int i = 0; i < warmPairs && !prevFrame.empty(); i++)
+    {
+        if (!stream.read(currFrame))
+        {
+            prevFrame.release();
+            break;
+        }
+        motionEstimation(prevFrame, currFrame);
+        prevFrame = currFrame;
+        currFrame = UMat();
+    }
+    bool havePair = !prevFrame.empty() && stream.read(currFrame);
+    if (!havePair && !resumed)
+    {
+        cout << "The video has no frame pair in the requested range" << endl;
+        exit(-1);
+    }
+    rotateFile(EXEC_TIME_FILE, EXEC_TIME_MAX_BYTES, EXEC_TIME_KEEP);
     ofstream execFile(EXEC_TIME_FILE, ios_base::app);
+    ofstream allocFile, perfFile;
+    PoolAllocator &pool = getPoolAllocator();
+    PerfCounters &perf = getPerfCounters();
 
-    newFrames.push_back(frames[0]);
+    if (pool.isInstalled())
+    {
+        allocFile.open(ALLOC_STATS_FILE, ios_base::app);
+        allocFile << "Per stage values are allocations/from system/bytes/peak live bytes\n";
+    }
+    if (perf.isEnabled())
+    {
+        perfFile.open(PERF_STATS_FILE, ios_base::app);
+        perf.writeLegend(perfFile);
+    }
+
+    if (!fromVectors && !mvOutputFile.empty() && !mvWriter.open(mvOutputFile, numPeaks, firstFrame))
+        exit(-1);
+    // the frames interpolated since the last checkpoint become a segment, then the state is saved
+    auto lastCheckpoint = chrono::steady_clock::now();
+    auto writeCheckpoint = [&](int nextFrame) {
+        uint64_t bytes = 0;
+        if (!writeSegment(checkpoint.segments, newFrames, newFPS, bytes))
+            exit(-1);
+        checkpoint.segments++;
+        checkpoint.bytesWritten += bytes;
+        checkpoint.nextFrame = nextFrame;
+        getMVField(field);
+        if (!saveCheckpoint(CHECKPOINT_FILE, checkpoint, field))
+        {
+            cout << "Could not write the checkpoint " << CHECKPOINT_FILE << endl;
+            exit(-1);
+        }
+        newFrames.clear();
+        lastCheckpoint = chrono::steady_clock::now();
+    };
 
-    for (int i = 0; i < frames.size() - 1; i += 1)
+    // the output goes to the checkpoint segments, the image sequence or the video as it is produced
+    int outputFrames = 0;
+    VideoWriter interpolatedVideo;
+    if (checkpointInterval == 0 && !isImageSequence(inputVideo))
+        interpolatedVideo.open(INTERPOLATED_VIDEO, VideoWriter::fourcc('X', 'V', 'I', 'D'), newFPS, Size(FRAME_WIDTH, FRAME_HEIGHT));
+    auto writeFrame = [&](const UMat &frame) {
+        if (checkpointInterval > 0)
+        {
+            newFrames.push_back(frame.clone()); // interpolatedFrame is overwritten by the next compensation
+        }
+        else if (isImageSequence(inputVideo))
+        {
+            // the frames keep their bit depth
+            if (!imwrite(format(INTERPOLATED_IMAGES, outputFrames), frame))
+            {
+                cout << "Could not write " << format(INTERPOLATED_IMAGES, outputFrames) << endl;
+                exit(-1);
+            }
+        }
+        else
+        {
+            interpolatedVideo << frame;
+        }
+        outputFrames++;
+    };
+
+    // the pairs of the span run from one key frame to the next, repeated frames are not key frames
+    // and the output between two key frames is interpolated over the whole gap. A frame is read ahead
+    // of the pair so that the last frame of the span is known, it is always a key frame
+    RepeatDetector repeats;
+    bool detectRepeats = dedup && !fromVectors;
+    int prevIndex = firstFrame;
+    if (detectRepeats && havePair)
+        repeats.start(prevFrame);
+    getMetrics().beginRun(inputVideo, (lastFrame < 0 ? getFrameCount(inputVideo) - 1 : lastFrame) - firstFrame);
+    while (havePair)
     {
+        int currIndex = stream.position() - 1;
+        UMat aheadFrame;
+        bool haveAhead = stream.read(aheadFrame);
+        if (detectRepeats && repeats.isRepeat(currFrame))
+        {
+            if (haveAhead)
+            {
+                currFrame = aheadFrame;
+                continue;
+            }
+            repeats.keepRepeat();
+        }
+        int steps = (currIndex - prevIndex) * rateFactor; // output frames from prevFrame up to currFrame
         auto start = chrono::high_resolution_clock::now();
+        if (pool.isInstalled())
+            pool.beginFrame();
+        perf.beginFrame();
 
         // You have 60 fps video as input. So you skip intermediate frames and try to get them through
         // interpolation eventually getting 60 fps. This will help if you want to compare original
@@ -260,28 +827,93 @@ void BlockMatchingCorrelation::interpolate()
 
         // You have 30 fps video as input and you are trying to get a 60 fps from it
         //cout << "Interpolating between frames : " << i << " and " << i+1 <<endl;
-        BMC(frames[i], frames[i + 1], interpolatedFrame);
-        newFrames.push_back(frames[i]);         // considering alternate frames for now
-        newFrames.push_back(interpolatedFrame); // considering alternate frames for now
+        if (fromVectors)
+        {
+            // only motion compensation is performed, the vectors were estimated by an earlier run
+            if (!mvReader.read(prevIndex, field))
+            {
+                cout << "The motion vector file covers the frame pairs " << mvReader.first() << " to " << mvReader.first() + mvReader.size() - 1
+                     << ", frame pair " << prevIndex << " is not in it" << endl;
+                exit(-1);
+            }
+            setMVField(field);
+        }
+        else
+        {
+            motionEstimation(prevFrame, currFrame);
+            if (mvWriter.isOpen())
+            {
+                // the file keeps one field per input frame pair, the repeats share the field of their gap
+                getMVField(field);
+                for (int k = prevIndex; k < currIndex; k++)
+                    mvWriter.write(field);
+            }
+        }
+        writeFrame(prevFrame);
+        for (int k = 1; k < steps; k++)
+        {
+            motionCompensation(prevFrame, currFrame, interpolatedFrame, (double)k / steps);
+            writeFrame(interpolatedFrame);
+        }
 
         auto stop = chrono::high_resolution_clock::now();
         auto duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
         writeToFile(execFile, duration);
+        getMetrics().pairDone(prevIndex, stageTimes, (double)duration.count());
+        if (pool.isInstalled())
+            pool.writeFrameStats(allocFile, prevIndex);
+        perf.writeFrameStats(perfFile, prevIndex);
+        if (checkpointInterval > 0 && msSince(lastCheckpoint) >= checkpointInterval * 1000)
+            writeCheckpoint(currIndex);
+
+        prevFrame = currFrame;
+        prevIndex = currIndex;
+        currFrame = aheadFrame;
+        havePair = haveAhead;
     }
-    newFrames.push_back(frames[frames.size() - 1]);
+    // a resumed job whose last pair was already done only has its last frame left, or nothing
+    // if the crash came after the last segment was written
+    if (!prevFrame.empty())
+        writeFrame(prevFrame);
     execFile.close();
-
-    cout << "Frame interpolation complete, creating new video..." << endl;
-
-    // create interpolated video
-    VideoWriter interpolatedVideo;
-    interpolatedVideo.open(INTERPOLATED_VIDEO, VideoWriter::fourcc('X', 'V', 'I', 'D'), newFPS, Size(FRAME_WIDTH, FRAME_HEIGHT));
-    //cout << "New frame size" << newFrames.size() << endl;
-
-    for (auto fr : newFrames) //for (int i = 0; i < 1; i++)
+    if (pool.isInstalled())
+    {
+        pool.writeRunStats(allocFile);
+        allocFile.close();
+    }
+    perf.writeRunStats(perfFile);
+    mvWriter.close();
+
+    if (sadCache.lookups > 0)
+        cout << "SAD cache : " << sadCache.hits << " of " << sadCache.lookups << " candidate SADs were duplicates ("
+             << 100.0 * sadCache.hits / sadCache.lookups << "%)" << endl;
+    cppcScheduler.printSummary();
+    printMatchingSummary();
+    if (dedup && fromVectors)
+        cout << "Repeated frames are not detected when rendering from a vector file" << endl;
+    const DedupStats &dedupStats = repeats.getStats();
+    if (dedupStats.duplicates > 0)
+        cout << "Repeated frames : " << dedupStats.duplicates << " of " << dedupStats.frames << " frames ("
+             << dedupStats.cadenceDuplicates << " through the cadence" << (dedupStats.period ? ", period " + to_string(dedupStats.period) : String())
+             << "), " << dedupStats.duplicates << " motion estimations skipped" << endl;
+
+    if (checkpointInterval > 0)
+    {
+        // the last segment holds the remaining frames, the segments are joined into the output.
+        // The next frame is past the end so that a job stopped before the stitch only stitches when resumed
+        cout << "Frame interpolation complete, creating new video..." << endl;
+        if (!newFrames.empty())
+            writeCheckpoint(prevIndex + 1);
+        if (!stitchSegments(checkpoint.segments, INTERPOLATED_VIDEO, newFPS))
+            exit(-1);
+        removeCheckpoint(CHECKPOINT_FILE, checkpoint.segments);
+        cout << "...completed the new video\nRelative Path of output video :" << INTERPOLATED_VIDEO << endl;
+        return;
+    }
+    if (isImageSequence(inputVideo))
     {
-        interpolatedVideo << fr;
-        //waitKey(25);
+        cout << "...completed the new image sequence\nRelative Path of output images :" << INTERPOLATED_IMAGES << endl;
+        return;
     }
     interpolatedVideo.release();
     cout << "...completed the new video\nRelative Path of output video :" << INTERPOLATED_VIDEO << endl;
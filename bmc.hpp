@@ -22,39 +22,147 @@
 #include <iostream>
 #include <fstream>
 #include "constants.hpp"
+#include "mv_sidecar.hpp"
+#include "pool_allocator.hpp"
+#include "perf_counters.hpp"
+#include "util.hpp"
+#include "presets.hpp"
+#include "cppc_scheduler.hpp"
+#include "quadtree.hpp"
+#include "full_search.hpp"
+#include "global_motion.hpp"
+#include "dedup.hpp"
 
 using namespace cv;
 using namespace std;
 
+// time in milliseconds spent in each stage for the last frame pair
+struct StageTimes
+{
+    double globalCPPC, localCPPC, BM, MC;
+};
+
 class BlockMatchingCorrelation
 {
     // variable declarations
     String inputVideo;
-    vector<UMat> frames;
     vector<vector<vector<Point2f>>> globalRegionMV;
     vector<vector<vector<Point2f>>> localRegionMV;
+    vector<vector<double>> globalRegionResponse; // peak response of each region, used as its confidence
+    vector<vector<double>> localRegionResponse;
     vector<vector<Point2f>> prevBlockMV;
     vector<vector<Point2f>> currBlockMV;
+    vector<vector<int>> blockSAD;   // SAD of the winning candidate of each block
+    RNG rng;                        // noise of the neighbor candidate, every engine has its own so that tiles can run concurrently
+    int rateFactor;                 // output fps = rateFactor * input fps
+    int numPeaks;                   // motion vector candidates per region found by CPPC
+    bool integerME;                 // see INTEGER_ME
+    bool verbose;                   // print the progress of every frame pair
+    bool localCPPC;                 // correlate the local regions, otherwise their vectors of the last pair are kept
+    StageTimes stageTimes;
+    SADCache sadCache;
+    SpeedPreset preset;
+    CPPCScheduler cppcScheduler; // decides which regions are correlated again for each frame pair
+    bool quadtree;               // variable block sizes, see quadtree.hpp
+    vector<QTBlock> partition;   // the blocks of the last frame pair when quadtree is set
+    size_t sadPixels;            // pixels compared by block matching, a measure of the SAD work
+    size_t matchedPairs;
+    size_t quadtreeBlocks[QUADTREE_LEVELS]; // blocks of every size, from QUADTREE_MAX_BLOCK down
+    int searchRange;             // half width of the full-search window around the best candidate, 0 to disable
+    SearchStats searchStats;
+    GlobalModel globalModel;     // camera motion model fitted to the region vectors, GLOBAL_OFF to disable
+    bool globalFit;              // the model fits the last frame pair, partition then holds the outlier blocks
+    Matx33d globalH;
+    GlobalMotionStats globalStats;
+    double levelScale; // SAD thresholds are given for 8-bit pixels, 257 for 16-bit frames
+    bool dedup; // repeated input frames are skipped and the gaps they leave are interpolated
+    String rangeStart, rangeEnd; // frame numbers or time stamps of the span to interpolate, empty for the whole video
+    double checkpointInterval; // seconds between two checkpoints, 0 to write the output only at the end
+    bool resume;               // continue from CHECKPOINT_FILE if it belongs to this job
+    String mvOutputFile;
+    MVSidecarWriter mvWriter;
+    MVSidecarReader mvReader;
 
 public:
     // function declarations
     BlockMatchingCorrelation(const String &inputVideo)
-        : globalRegionMV(NUM_GR_Y, vector<vector<Point2f>>(NUM_GR_X, vector<Point2f>(2, Point2f(0, 0)))),
-          localRegionMV(NUM_LR_Y, vector<vector<Point2f>>(NUM_LR_X, vector<Point2f>(2, Point2f(0, 0)))),
+        : globalRegionMV(NUM_GR_Y, vector<vector<Point2f>>(NUM_GR_X, vector<Point2f>(PHASE_CORR_PEAKS, Point2f(0, 0)))),
+          localRegionMV(NUM_LR_Y, vector<vector<Point2f>>(NUM_LR_X, vector<Point2f>(PHASE_CORR_PEAKS, Point2f(0, 0)))),
+          globalRegionResponse(NUM_GR_Y, vector<double>(NUM_GR_X, 0.0)),
+          localRegionResponse(NUM_LR_Y, vector<double>(NUM_LR_X, 0.0)),
           prevBlockMV(NUM_BLOCKS_Y, vector<Point2f>(NUM_BLOCKS_X, Point2f(0, 0))),
-          currBlockMV(NUM_BLOCKS_Y, vector<Point2f>(NUM_BLOCKS_X, Point2f(0, 0)))
+          currBlockMV(NUM_BLOCKS_Y, vector<Point2f>(NUM_BLOCKS_X, Point2f(0, 0))),
+          blockSAD(NUM_BLOCKS_Y, vector<int>(NUM_BLOCKS_X, 0)),
+          rateFactor(2),
+          numPeaks(PHASE_CORR_PEAKS),
+          integerME(INTEGER_ME),
+          verbose(true),
+          localCPPC(true),
+          stageTimes(),
+          quadtree(false),
+          sadPixels(0),
+          matchedPairs(0),
+          searchRange(0),
+          globalModel(GLOBAL_OFF),
+          globalFit(false),
+          levelScale(1.0),
+          dedup(false),
+          checkpointInterval(0),
+          resume(false)
 
     {
         // initialization of variables
         this->inputVideo = inputVideo;
+        getSpeedPreset(DEFAULT_PRESET, preset);
+        fill(quadtreeBlocks, quadtreeBlocks + QUADTREE_LEVELS, 0);
+        searchStats = SearchStats();
+        globalStats = GlobalMotionStats();
     }
 
     void divideIntoGlobal(const UMat &inpFrame, vector<UMat> &globalRegions);
     void divideIntoLocal(const UMat &inpFrame, vector<UMat> &localRegions);
     void divideIntoBlocks(const UMat &inpFrame, vector<vector<UMat>> &blockRegions);
+    void standardRegion(const UMat &region, UMat &region32f);
     void customisedPhaseCorr(const UMat &prev, const UMat &curr);
+    void regionCandidates(int i, int j, vector<Point2f> &candidates) const;
+    void fitGlobalMotion();
     void blockMatching(const UMat &prev, const UMat &curr);
+    void mergeBlocks(const Mat &prevInt, const Mat &currInt, vector<vector<char>> &merged);
+    void splitBlocks(const Mat &prevInt, const Mat &currInt, const vector<vector<char>> &merged, const vector<vector<char>> &global);
+    void printMatchingSummary() const;
+    void motionEstimation(const UMat &prev, const UMat &curr);
+    void motionCompensation(const UMat &prev, const UMat &curr, UMat &interpolatedFrame, double t = 0.5);
     void BMC(const UMat &prev, const UMat &curr, UMat &interpolatedFrame);
+    void getMVField(MVField &field) const;
+    void setMVField(const MVField &field);
+    void saveVectors(const String &mvFile) { mvOutputFile = mvFile; } // write the MV field of every frame pair to mvFile
+    bool renderFromVectors(const String &mvFile); // skip motion estimation, read the MV fields from mvFile
+    void setRateFactor(int factor) { rateFactor = factor; }
+    void setNumPeaks(int peaks);
+    void setIntegerME(bool enable) { integerME = enable; }
+    bool setPreset(const String &name) { return getSpeedPreset(name, preset); }
+    void usePoolAllocator() { getPoolAllocator().install(); }
+    void usePerfCounters() { getPerfCounters().enable(); }
+    void setVerbose(bool enable) { verbose = enable; }
+    void setLocalCPPC(bool enable) { localCPPC = enable; }
+    void setQuadtree(bool enable) { quadtree = enable; }
+    void setSearchRange(int range) { searchRange = range; }
+    bool setGlobalModel(const String &name) { return getGlobalModel(name, globalModel); }
+    GlobalModel getGlobalModelType() const { return globalModel; }
+    void setDedup(bool enable) { dedup = enable; }
+    void setCPPCReuse(bool enable) { cppcScheduler.setEnabled(enable); } // reuse the region vectors while motion is stable
+    const StageTimes &getStageTimes() const { return stageTimes; }
+    void setFrameRange(const String &start, const String &end) { rangeStart = start, rangeEnd = end; }
+    bool getFrameRange(int &first, int &last) const;
+    void setCheckpoint(double seconds) { checkpointInterval = seconds; }
+    void setResume(bool enable) { resume = enable; }
+    void copySettings(const BlockMatchingCorrelation &other);
+    int getRateFactor() const { return rateFactor; }
+    bool usesVectorFiles() const { return !mvOutputFile.empty() || mvReader.isOpen(); }
+    const vector<vector<Point2f>> &getBlockMV() const { return prevBlockMV; }
+    size_t getSADPixels() const { return sadPixels; } // since the engine was created
+    bool getGlobalMotion(Matx33d &H) const { H = globalH; return globalFit; } // false if the model did not fit the last pair
+    void setBlockMV(const vector<vector<Point2f>> &blockMV) { prevBlockMV = blockMV, partition.clear(), globalFit = false; }
     void interpolate();
 };
 
@@ -62,5 +170,7 @@ static const vector<vector<Point2f>> zeroes = vector<vector<Point2f>>(NUM_BLOCKS
 static const Size stdSize = Size(STANDARD_REGION_WIDTH, STANDARD_REGION_HEIGHT);
 
 #define EXEC_TIME_FILE "execution-time.txt"
+#define EXEC_TIME_MAX_BYTES (4 * 1024 * 1024) // EXEC_TIME_FILE is rotated to .1, .2, ... once it grows past this
+#define EXEC_TIME_KEEP 3                       // rotated files kept
 
 #endif
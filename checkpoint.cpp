@@ -0,0 +1,148 @@
+/*
+****************************************
+* This file contains the definitions of
+* the checkpoints of a long conversion.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <opencv2/videoio.hpp>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include "checkpoint.hpp"
+
+using namespace cv;
+using namespace std;
+
+bool saveCheckpoint(const String &fileName, const CheckpointHeader &header, const MVField &field)
+{
+    vector<float> record;
+    String tmpName = fileName + ".tmp";
+    packMVField(field, header.numPeaks, record);
+
+    int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    size_t size = record.size() * sizeof(float);
+    bool ok = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+              write(fd, record.data(), size) == (ssize_t)size &&
+              fsync(fd) == 0;
+    close(fd);
+    // the rename replaces the previous checkpoint in one step
+    if (!ok || rename(tmpName.c_str(), fileName.c_str()) != 0)
+    {
+        unlink(tmpName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadCheckpoint(const String &fileName, CheckpointHeader &header, MVField &field)
+{
+    ifstream file(fileName, ios_base::binary);
+    if (!file || !file.read((char *)&header, sizeof(header)))
+        return false;
+    if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.version != CHECKPOINT_VERSION || header.numPeaks < 1)
+    {
+        cout << "Checkpoint " << fileName << " does not match this build" << endl;
+        return false;
+    }
+    header.input[sizeof(header.input) - 1] = '\0';
+
+    vector<float> record(mvRecordFloats(header.numPeaks));
+    if (!file.read((char *)record.data(), record.size() * sizeof(float)))
+        return false;
+    unpackMVField(record.data(), header.numPeaks, field);
+
+    // every segment listed in the checkpoint must still be there
+    uint64_t bytes = 0;
+    for (uint32_t k = 0; k < header.segments; k++)
+    {
+        struct stat st;
+        if (stat(segmentName(k).c_str(), &st) != 0)
+        {
+            cout << "Segment " << segmentName(k) << " of the checkpoint is missing" << endl;
+            return false;
+        }
+        bytes += st.st_size;
+    }
+    if (bytes != header.bytesWritten)
+    {
+        cout << "The segments of the checkpoint have " << bytes << " bytes, " << header.bytesWritten << " were written" << endl;
+        return false;
+    }
+    return true;
+}
+
+String segmentName(int index, const String &prefix)
+{
+    return format("%s.part%03d.avi", prefix.c_str(), index);
+}
+
+bool openSegment(VideoWriter &segment, int index, double fps, Size size, const String &prefix)
+{
+    segment.open(segmentName(index, prefix), VideoWriter::fourcc('F', 'F', 'V', '1'), fps, size);
+    if (!segment.isOpened())
+    {
+        cout << "Could not create the segment " << segmentName(index, prefix) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool writeSegment(int index, const vector<UMat> &frames, double fps, uint64_t &bytes)
+{
+    VideoWriter segment;
+    struct stat st;
+
+    if (frames.empty())
+        return true;
+    if (!openSegment(segment, index, fps, frames[0].size()))
+        return false;
+    for (auto &fr : frames)
+        segment << fr;
+    segment.release();
+    if (stat(segmentName(index).c_str(), &st) != 0)
+        return false;
+    bytes = st.st_size;
+    return true;
+}
+
+bool stitchSegments(int count, const String &output, double fps, const String &prefix)
+{
+    VideoWriter interpolatedVideo;
+    for (int k = 0; k < count; k++)
+    {
+        VideoCapture segment(segmentName(k, prefix));
+        UMat fr;
+        if (!segment.isOpened())
+        {
+            cout << "Could not open the segment " << segmentName(k, prefix) << endl;
+            return false;
+        }
+        while (segment.read(fr))
+        {
+            if (!interpolatedVideo.isOpened())
+                interpolatedVideo.open(output, VideoWriter::fourcc('X', 'V', 'I', 'D'), fps, fr.size());
+            interpolatedVideo << fr;
+        }
+    }
+    interpolatedVideo.release();
+    return true;
+}
+
+void removeSegments(int count, const String &prefix)
+{
+    for (int k = 0; k < count; k++)
+        unlink(segmentName(k, prefix).c_str());
+}
+
+void removeCheckpoint(const String &fileName, int segments)
+{
+    removeSegments(segments);
+    unlink(fileName.c_str());
+}
@@ -0,0 +1,60 @@
+/*
+****************************************
+* This file contains the declaration
+* of the checkpoints of a long
+* conversion. The output is written in
+* segments, and after every segment the
+* state needed to continue (the next
+* frame pair and the last MV field) is
+* saved, so that a job that was stopped
+* resumes from its last checkpoint.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+/*
+* File layout : CheckpointHeader, then one MV sidecar record (see mv_sidecar.hpp) with the
+* vector field of the last frame pair. The file is written to CHECKPOINT_FILE ".tmp" and
+* renamed, so a crash while writing leaves the previous checkpoint intact.
+* Segments are lossless (FFV1) and are stitched into INTERPOLATED_VIDEO at the end.
+*/
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <stdint.h>
+#include "mv_sidecar.hpp"
+
+using namespace cv;
+using namespace std;
+
+#define CHECKPOINT_MAGIC "BMCCKP01"
+#define CHECKPOINT_VERSION 1
+
+struct CheckpointHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t rateFactor;
+    uint32_t numPeaks;
+    uint32_t segments;     // segments written so far
+    int64_t nextFrame;     // first frame of the next frame pair to interpolate
+    int64_t lastFrame;     // last frame of the span, -1 for the end of the video
+    uint64_t bytesWritten; // total size of the segments
+    char input[512];       // path of the input video
+};
+
+bool saveCheckpoint(const String &fileName, const CheckpointHeader &header, const MVField &field);
+bool loadCheckpoint(const String &fileName, CheckpointHeader &header, MVField &field);
+// prefix is the output the segments belong to, the segment mode writes its chunks under another prefix
+String segmentName(int index, const String &prefix = INTERPOLATED_VIDEO);
+bool openSegment(VideoWriter &segment, int index, double fps, Size size, const String &prefix = INTERPOLATED_VIDEO);
+bool writeSegment(int index, const vector<UMat> &frames, double fps, uint64_t &bytes);
+bool stitchSegments(int count, const String &output, double fps, const String &prefix = INTERPOLATED_VIDEO);
+void removeSegments(int count, const String &prefix = INTERPOLATED_VIDEO);
+void removeCheckpoint(const String &fileName, int segments);
+
+#define CHECKPOINT_FILE "checkpoint.bmc"
+
+#endif
@@ -35,9 +35,113 @@
 #define NUM_BLOCKS_X FRAME_WIDTH / BLOCK_SIZE // 1920/BLOCK_SIZE -> 60
 #define NUM_BLOCKS_Y 34                       // 1080/BLOCK_SIZE -> 33.75 = 34 (approx.)
 
+// 1 : motion estimation works on the 8 or 16-bit luma with integer SADs, only the FFT input is float
+// 0 : the luma is converted to float before motion estimation
+// The two paths have not been timed against each other yet, make compare-me in benchmark/ appends the table
+#define INTEGER_ME 1
+
+// number of displacements remembered by the SAD cache of a block
+#define SAD_CACHE_SIZE 16
+
+// number of peaks (motion vector candidates) returned by phase correlation for each region
+#define PHASE_CORR_PEAKS 2
+// minimum distance in pixels between two peaks of the correlation surface
+#define PEAK_SEPARATION 3
+
 #define STANDARD_REGION_WIDTH 128
 #define STANDARD_REGION_HEIGHT 64
 
+// minimum overlap in pixels between neighboring tiles of inputs larger than FRAME_WIDTH x FRAME_HEIGHT,
+// the blocks on a seam are matched with this much context and the tiles are blended across it
+#define TILE_MIN_OVERLAP (2 * BLOCK_SIZE)
+
+// batch mode : frame pairs processed by a task before it yields to the other jobs
+#define BATCH_PAIRS_PER_TASK 8
+// batch mode : frame sized buffers a running job is expected to hold (frames, colour spaces, blocks, encoder)
+#define BATCH_FRAME_COPIES 12
+// batch mode : default memory budget of all running jobs in MB
+#define BATCH_MEMORY_BUDGET 2048
+
+// realtime mode : a level is only chosen if its expected cost times this margin fits in the time left
+#define DEADLINE_MARGIN 1.2
+// realtime mode : the pair latencies are counted in a histogram of LATENCY_BINS bins of LATENCY_BIN_MS,
+// the last bin holds every longer pair
+#define LATENCY_BIN_MS 0.5
+#define LATENCY_BINS 2000
+
+// CPPC reuse : pairs whose region vectors moved less than CPPC_STABLE_CHANGE pixels on average
+// before the scheduler starts reusing them
+#define CPPC_STABLE_PAIRS 3
+#define CPPC_STABLE_CHANGE 1.0
+// CPPC reuse : once stable, CPPC_SKIP_PAIRS pairs skip CPPC and the next one refreshes every CPPC_ROTATION-th region
+#define CPPC_SKIP_PAIRS 2
+#define CPPC_ROTATION 4
+// CPPC reuse : a full refresh is forced when the peak response falls below this fraction of the last full
+// refresh, or when the mean block SAD rises above CPPC_SAD_RISE times the one of the last full refresh
+#define CPPC_RESPONSE_DROP 0.7
+#define CPPC_SAD_RISE 1.5
+
+// segment mode : pairs estimated before the start of a chunk so that its first pairs have a previous MV field
+#define SEGMENT_WARMUP 4
+// segment mode : pairs after every chunk boundary compared against a serial run with --check-seams
+#define SEAM_CHECK_PAIRS 2
+// segment mode : every chunk writes its output to a lossless segment under this prefix, they are stitched at the end
+#define SEGMENT_CHUNK_PREFIX INTERPOLATED_VIDEO ".chunk"
+
+// shard mode : frame pairs per task handed to a worker process, and how often a failed task is retried
+#define SHARD_PAIRS 64
+#define SHARD_MAX_RETRIES 2
+// shard mode : seconds after which a worker that has not returned its task is considered hung
+#define SHARD_TASK_TIMEOUT 600
+
+// checkpoints : seconds between two checkpoints when --checkpoint is given without a value or with --resume
+#define CHECKPOINT_INTERVAL 5
+
+// quadtree block sizes : 2x2 blocks are merged into one node, a block is split down to QUADTREE_MIN_BLOCK
+#define QUADTREE_MAX_BLOCK (2 * BLOCK_SIZE)
+#define QUADTREE_MIN_BLOCK 8
+#define QUADTREE_LEVELS 4 // 64, 32, 16 and 8
+// a node is merged when its mean absolute difference per pixel is at most QUADTREE_MERGE_SAD,
+// a block is split when it is above QUADTREE_SPLIT_SAD
+#define QUADTREE_MERGE_SAD 2.0
+#define QUADTREE_SPLIT_SAD 6.0
+
+// global motion : a region vector is an inlier of the model when it is within GLOBAL_MOTION_THRESHOLD pixels,
+// the model is used when GLOBAL_MOTION_INLIERS of the regions are inliers
+#define GLOBAL_MOTION_THRESHOLD 1.0
+#define GLOBAL_MOTION_INLIERS 0.75
+// a block takes the model vector when its mean absolute difference per pixel is at most GLOBAL_MOTION_SAD
+#define GLOBAL_MOTION_SAD 4.0
+
+// duplicate frames : thumbnail compared between frames (a quarter of the frame size), its tiles of
+// DEDUP_TILE x DEDUP_TILE pixels and the thresholds of a repeat, at most DUPLICATE_HASH_BITS differing
+// hash bits and at most DUPLICATE_SAD mean absolute difference per pixel in every tile, so that
+// motion confined to a small part of the frame is not averaged away
+#define DEDUP_THUMB_WIDTH 480
+#define DEDUP_THUMB_HEIGHT 270
+#define DEDUP_TILE 15
+#define DUPLICATE_HASH_BITS 2
+#define DUPLICATE_SAD 2.0
+// cadence : longest repeat period looked for (5 for 3:2 pulldown), periods it has to hold for,
+// and how much looser the threshold is at the repeat positions of a locked cadence
+#define CADENCE_MAX_PERIOD 5
+#define CADENCE_CYCLES 3
+#define CADENCE_TOLERANCE 3.0
+
+// frame server : decoded frames and MV fields kept in its caches, and how close (in frames) a time stamp
+// has to be to a frame to return that frame without interpolation
+#define FRAME_SERVER_FRAMES 16
+#define FRAME_SERVER_FIELDS 64
+#define FRAME_SERVER_SNAP 1e-3
+
+// metrics endpoint : pending connections and how often the serving thread checks whether to stop
+#define METRICS_BACKLOG 8
+#define METRICS_POLL_MS 200
+
 #define INTERPOLATED_VIDEO "video/output.avi"
+// image sequence inputs (e.g. 16-bit PNG or TIFF masters) have no frame rate and are written as an image sequence
+#define IMAGE_SEQUENCE_FPS 24
+#define INTERPOLATED_IMAGES "video/output-%06d.png"
+#define FRAME_AT_IMAGE "video/frame-at-%.3f.png" // --frame-at writes the requested frames here
 
 #endif
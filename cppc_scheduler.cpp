@@ -0,0 +1,96 @@
+/*
+****************************************
+* This file contains the definitions of
+* the CPPC scheduler.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <iostream>
+#include "cppc_scheduler.hpp"
+
+using namespace cv;
+using namespace std;
+
+CPPCScheduler::CPPCScheduler()
+    : enabled(false), mode(CPPC_FULL), forceFull(true), stablePairs(0), skipped(0), phase(0),
+      changeSum(0), responseSum(0), probes(0), refResponse(0), refSAD(0),
+      dueRegions(0), savedRegions(0), fullRefreshes(0)
+{
+}
+
+CPPCMode CPPCScheduler::beginPair()
+{
+    changeSum = responseSum = 0;
+    probes = 0;
+    if (!enabled || forceFull || stablePairs < CPPC_STABLE_PAIRS)
+        mode = CPPC_FULL;
+    else if (skipped < CPPC_SKIP_PAIRS)
+        mode = CPPC_SKIP;
+    else
+        mode = CPPC_ROTATING;
+
+    if (mode == CPPC_SKIP)
+    {
+        skipped++;
+    }
+    else
+    {
+        skipped = 0;
+        if (mode == CPPC_ROTATING)
+            phase = (phase + 1) % CPPC_ROTATION;
+    }
+    return mode;
+}
+
+bool CPPCScheduler::refresh(int region) const
+{
+    if (mode == CPPC_ROTATING)
+        return region % CPPC_ROTATION == phase;
+    return mode == CPPC_FULL;
+}
+
+void CPPCScheduler::observe(const Point2f &oldMV, const Point2f &newMV, double response)
+{
+    // the change is measured against the vector the region had at its last refresh
+    changeSum += norm(newMV - oldMV);
+    responseSum += response;
+    probes++;
+}
+
+bool CPPCScheduler::confidenceDropped() const
+{
+    if (probes == 0)
+        return false;
+    return changeSum / probes > CPPC_STABLE_CHANGE || responseSum / probes < CPPC_RESPONSE_DROP * refResponse;
+}
+
+void CPPCScheduler::endPair(double meanBlockSAD)
+{
+    if (mode == CPPC_FULL)
+    {
+        fullRefreshes++;
+        forceFull = false;
+        if (probes > 0)
+            refResponse = responseSum / probes;
+        refSAD = meanBlockSAD;
+    }
+    if (mode != CPPC_SKIP)
+        stablePairs = probes > 0 && changeSum / probes <= CPPC_STABLE_CHANGE ? stablePairs + 1 : 0;
+
+    // reused vectors that no longer match the frames show up as a rise of the block SAD
+    if (mode != CPPC_FULL && meanBlockSAD > CPPC_SAD_RISE * refSAD)
+    {
+        forceFull = true;
+        stablePairs = 0;
+    }
+}
+
+void CPPCScheduler::printSummary() const
+{
+    if (!enabled || dueRegions == 0)
+        return;
+    cout << "CPPC reuse : " << savedRegions << " of " << dueRegions << " region correlations skipped ("
+         << 100.0 * savedRegions / dueRegions << "%), " << FFTS_PER_CORRELATION * savedRegions << " FFTs saved, "
+         << fullRefreshes << " full refreshes" << endl;
+}
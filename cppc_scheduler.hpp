@@ -0,0 +1,62 @@
+/*
+****************************************
+* This file contains the declaration
+* of the CPPC scheduler. When the region
+* vectors barely change from one frame
+* pair to the next (e.g. a steady camera
+* pan), CPPC is skipped for a few pairs
+* or only a rotating subset of the
+* regions is correlated again. A drop in
+* confidence forces a full refresh.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef CPPC_SCHEDULER_HPP
+#define CPPC_SCHEDULER_HPP
+
+#include <opencv2/core.hpp>
+#include "constants.hpp"
+
+using namespace cv;
+using namespace std;
+
+// global regions are numbered first, then the local regions, row by row
+#define NUM_CPPC_REGIONS (NUM_GR_X * NUM_GR_Y + NUM_LR_X * NUM_LR_Y)
+#define FFTS_PER_CORRELATION 3 // two forward transforms and one inverse
+
+enum CPPCMode
+{
+    CPPC_FULL,     // every region is correlated
+    CPPC_ROTATING, // every CPPC_ROTATION-th region is correlated, the others keep their vectors
+    CPPC_SKIP      // no region is correlated
+};
+
+class CPPCScheduler
+{
+    bool enabled;
+    CPPCMode mode;
+    bool forceFull;
+    int stablePairs; // consecutive pairs in which the refreshed regions barely moved
+    int skipped;     // pairs skipped since the last refresh
+    int phase;       // subset of regions refreshed by the next rotating pair
+    double changeSum, responseSum;
+    int probes;
+    double refResponse, refSAD; // mean peak response and block SAD of the last full refresh
+
+public:
+    size_t dueRegions, savedRegions, fullRefreshes;
+
+    CPPCScheduler();
+    void setEnabled(bool enable) { enabled = enable; }
+    bool isEnabled() const { return enabled; }
+    CPPCMode beginPair();
+    bool refresh(int region) const;
+    void observe(const Point2f &oldMV, const Point2f &newMV, double response);
+    bool confidenceDropped() const;
+    void upgradeToFull() { mode = CPPC_FULL; }
+    void endPair(double meanBlockSAD);
+    void printSummary() const;
+};
+
+#endif
@@ -0,0 +1,131 @@
+/*
+****************************************
+* This file contains the definitions of
+* the duplicate frame detector.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <opencv2/imgproc.hpp>
+#include "dedup.hpp"
+
+using namespace cv;
+using namespace std;
+
+void CadenceDetector::push(bool repeat)
+{
+    // the cadence is locked on the shortest period whose repeat pattern held for CADENCE_CYCLES periods
+    history.push_back(repeat);
+    if ((int)history.size() > CADENCE_CYCLES * CADENCE_MAX_PERIOD)
+        history.erase(history.begin());
+
+    period = 0;
+    for (int p = 2; p <= CADENCE_MAX_PERIOD && !period; p++)
+    {
+        int n = (int)history.size();
+        if (n < CADENCE_CYCLES * p)
+            continue;
+        bool holds = true, repeats = false, unique = false;
+        for (int k = n - CADENCE_CYCLES * p; k < n && holds; k++)
+        {
+            if (k + p < n)
+                holds = history[k] == history[k + p];
+            repeats |= history[k] != 0;
+            unique |= history[k] == 0;
+        }
+        if (holds && repeats && unique)
+            period = p;
+    }
+}
+
+bool CadenceDetector::expectsRepeat() const
+{
+    return period > 0 && history[history.size() - period] != 0;
+}
+
+void frameSignature(const UMat &frame, FrameSignature &signature)
+{
+    UMat gray;
+    Mat hashImage;
+
+    cvtColor(frame, gray, COLOR_BGR2GRAY);
+    resize(gray, signature.thumb, Size(DEDUP_THUMB_WIDTH, DEDUP_THUMB_HEIGHT), 0, 0, INTER_AREA);
+    if (signature.thumb.depth() != CV_8U)
+        signature.thumb.convertTo(signature.thumb, CV_8U, 255.0 / 65535.0); // the thresholds are for 8-bit pixels
+    resize(signature.thumb, hashImage, Size(9, 8), 0, 0, INTER_AREA);
+    signature.hash = 0;
+    for (int y = 0; y < 8; y++)
+        for (int x = 0; x < 8; x++)
+            signature.hash = (signature.hash << 1) | (hashImage.at<uchar>(y, x) < hashImage.at<uchar>(y, x + 1));
+}
+
+double signatureDistance(const FrameSignature &a, const FrameSignature &b, int &hashBits)
+{
+    /* the largest mean absolute difference per pixel among the tiles of the thumbnails */
+    Mat diff, tileMeans;
+    double largest;
+    hashBits = __builtin_popcountll(a.hash ^ b.hash);
+    absdiff(a.thumb, b.thumb, diff);
+    diff.convertTo(diff, CV_32F); // area resizing of 8-bit pixels would round the means
+    resize(diff, tileMeans, Size(diff.cols / DEDUP_TILE, diff.rows / DEDUP_TILE), 0, 0, INTER_AREA);
+    minMaxLoc(tileMeans, NULL, &largest);
+    return largest;
+}
+
+void RepeatDetector::start(const UMat &frame)
+{
+    cadence = CadenceDetector();
+    stats = DedupStats();
+    stats.frames = 1;
+    frameSignature(frame, last);
+}
+
+bool RepeatDetector::isRepeat(const UMat &frame)
+{
+    int hashBits;
+    frameSignature(frame, current);
+    double distance = signatureDistance(last, current, hashBits);
+    bool repeat = hashBits <= DUPLICATE_HASH_BITS && distance <= DUPLICATE_SAD;
+    if (!repeat && cadence.expectsRepeat() && hashBits <= DUPLICATE_HASH_BITS && distance <= CADENCE_TOLERANCE * DUPLICATE_SAD)
+    {
+        repeat = true;
+        stats.cadenceDuplicates++;
+    }
+    cadence.push(repeat);
+    if (cadence.getPeriod() > 0)
+        stats.period = cadence.getPeriod();
+
+    stats.frames++;
+    if (repeat)
+    {
+        stats.duplicates++;
+        return true;
+    }
+    swap(last, current); // the thumbnail buffers are reused, a copy would share the buffer current is resized into
+    return false;
+}
+
+void RepeatDetector::keepRepeat()
+{
+    stats.duplicates--;
+    swap(last, current);
+}
+
+void findKeyFrames(const vector<UMat> &frames, int first, vector<int> &keyFrames, DedupStats &stats)
+{
+    RepeatDetector detector;
+
+    keyFrames.assign(1, first);
+    detector.start(frames[first]);
+    for (int i = first + 1; i < (int)frames.size(); i++)
+    {
+        if (detector.isRepeat(frames[i]))
+        {
+            if (i < (int)frames.size() - 1)
+                continue;
+            detector.keepRepeat(); // the last frame is always kept
+        }
+        keyFrames.push_back(i);
+    }
+    stats = detector.getStats();
+}
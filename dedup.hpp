@@ -0,0 +1,80 @@
+/*
+****************************************
+* This file contains the declaration
+* of the duplicate frame detector.
+* Upconverted and telecined sources
+* repeat frames, a pair of identical
+* frames needs no motion estimation.
+* Every frame is reduced to a luma
+* thumbnail and a 64-bit difference
+* hash, a frame is a repeat of the last
+* unique frame when the hash and every
+* tile of the thumbnail barely differ. A repeat
+* pattern that recurs with a fixed
+* period (3:2 pulldown repeats one frame
+* in five at 30 fps, 30 fps doubled to
+* 60 fps every other frame) locks the
+* cadence, near-repeats at its repeat
+* positions are then accepted with a
+* looser threshold.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef DEDUP_HPP
+#define DEDUP_HPP
+
+#include <opencv2/core.hpp>
+#include <stdint.h>
+#include "constants.hpp"
+
+using namespace cv;
+using namespace std;
+
+struct FrameSignature
+{
+    uint64_t hash; // bit set where a pixel of the 9x8 luma is darker than its right neighbor
+    Mat thumb;     // DEDUP_THUMB_WIDTH x DEDUP_THUMB_HEIGHT luma
+};
+
+struct DedupStats
+{
+    size_t frames;
+    size_t duplicates;
+    size_t cadenceDuplicates; // accepted only because the cadence predicted a repeat
+    int period;               // period of the locked cadence, 0 if none was found
+};
+
+class CadenceDetector
+{
+    vector<char> history; // 1 for every frame that repeated the previous unique frame
+    int period;
+
+public:
+    CadenceDetector() : period(0) {}
+    void push(bool repeat);
+    bool expectsRepeat() const; // the locked cadence has a repeat at the next frame
+    int getPeriod() const { return period; }
+};
+
+// decides frame by frame whether a frame repeats the last key frame, for inputs that are read one frame at a time
+class RepeatDetector
+{
+    FrameSignature last, current;
+    CadenceDetector cadence;
+    DedupStats stats;
+
+public:
+    RepeatDetector() : stats() {}
+    void start(const UMat &frame);     // frame is the first key frame
+    bool isRepeat(const UMat &frame);  // a frame that is not a repeat becomes the last key frame
+    void keepRepeat();                 // the frame isRepeat just reported is kept as a key frame anyway
+    const DedupStats &getStats() const { return stats; }
+};
+
+void frameSignature(const UMat &frame, FrameSignature &signature);
+double signatureDistance(const FrameSignature &a, const FrameSignature &b, int &hashBits); // largest mean absolute difference per pixel of a tile
+// the frames from first on that are not repeats, first and the last frame are always kept
+void findKeyFrames(const vector<UMat> &frames, int first, vector<int> &keyFrames, DedupStats &stats);
+
+#endif
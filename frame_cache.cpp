@@ -0,0 +1,205 @@
+/*
+****************************************
+* This file contains the definitions of
+* the decoded frame cache.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <opencv2/videoio.hpp>
+#include <opencv2/imgproc.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include "frame_cache.hpp"
+
+using namespace cv;
+using namespace std;
+
+static String cacheDir; // empty while the cache is disabled
+
+struct CacheMapping
+{
+    const uchar *data;
+    size_t size;
+    vector<Mat> frames;
+
+    CacheMapping() : data(NULL), size(0) {}
+    CacheMapping(const CacheMapping &) = delete; // owns the mapping
+    CacheMapping &operator=(const CacheMapping &) = delete;
+    ~CacheMapping()
+    {
+        if (data)
+            munmap((void *)data, size);
+    }
+};
+
+void enableFrameCache(const String &dir)
+{
+    cacheDir = dir;
+    mkdir(cacheDir.c_str(), 0755);
+}
+
+bool frameCacheEnabled()
+{
+    return !cacheDir.empty();
+}
+
+static bool hashFile(const String &fileName, uint64_t &hash)
+{
+    /* FNV-1a over the size and modification time of the file and its first and last FRAME_CACHE_HASH_BYTES */
+    struct stat st;
+    ifstream file(fileName, ios_base::binary);
+    if (!file || stat(fileName.c_str(), &st) != 0)
+        return false;
+    uint64_t size = (uint64_t)st.st_size;
+    uint64_t mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec;
+    vector<char> buffer(FRAME_CACHE_HASH_BYTES);
+    hash = 14695981039346656037ULL;
+    for (uint64_t value : {size, mtime})
+        for (int k = 0; k < 8; k++)
+            hash = (hash ^ ((value >> (8 * k)) & 0xff)) * 1099511628211ULL;
+    for (uint64_t offset : {(uint64_t)0, size > FRAME_CACHE_HASH_BYTES ? size - FRAME_CACHE_HASH_BYTES : 0})
+    {
+        file.seekg(offset);
+        file.read(buffer.data(), buffer.size());
+        for (streamsize k = 0; k < file.gcount(); k++)
+            hash = (hash ^ (uchar)buffer[k]) * 1099511628211ULL;
+        file.clear();
+    }
+    return true;
+}
+
+static bool writeCache(const String &videoFile, const String &cacheFile, Size size, FrameCacheHeader &header)
+{
+    /* decodes the whole video into cacheFile, frames are written as they are decoded */
+    VideoCapture cap(videoFile);
+    if (!cap.isOpened())
+        return false;
+    String tmpName = cacheFile + ".tmp";
+    int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    header.fps = cap.get(CAP_PROP_FPS);
+    header.frameBytes = (size.area() * CV_ELEM_SIZE(header.type) + page - 1) / page * page;
+    header.numFrames = 0;
+    vector<uchar> padding(header.frameBytes);
+    bool ok = true;
+    Mat fr;
+    while (ok && cap.read(fr))
+    {
+        if (fr.size() != size)
+            resize(fr, fr, size);
+        if (fr.type() != header.type)
+        {
+            ok = false;
+            break;
+        }
+        // rows are written one by one, the decoder may return a padded Mat
+        off_t offset = FRAME_CACHE_DATA_OFFSET + header.numFrames * header.frameBytes;
+        for (int y = 0; y < fr.rows && ok; y++)
+            ok = pwrite(fd, fr.ptr(y), fr.cols * fr.elemSize(), offset + y * fr.cols * fr.elemSize()) == (ssize_t)(fr.cols * fr.elemSize());
+        header.numFrames++;
+    }
+    // the file is extended to its full size before the header marks it complete
+    ok = ok && header.numFrames > 0 && ftruncate(fd, FRAME_CACHE_DATA_OFFSET + header.numFrames * header.frameBytes) == 0 &&
+         pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpName.c_str(), cacheFile.c_str()) != 0)
+    {
+        unlink(tmpName.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool mapCache(const String &cacheFile, const FrameCacheHeader &expected, CacheMapping &mapping)
+{
+    struct stat st;
+    int fd = open(cacheFile.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < FRAME_CACHE_DATA_OFFSET)
+    {
+        close(fd);
+        return false;
+    }
+    // private and writable so that a caller writing into a frame gets its own copy of the page
+    void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid after the descriptor is closed
+    if (addr == MAP_FAILED)
+        return false;
+
+    FrameCacheHeader header;
+    memcpy(&header, addr, sizeof(header));
+    if (memcmp(header.magic, FRAME_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != FRAME_CACHE_VERSION ||
+        header.width != expected.width || header.height != expected.height || header.type != expected.type ||
+        header.sourceHash != expected.sourceHash ||
+        FRAME_CACHE_DATA_OFFSET + header.numFrames * header.frameBytes > (uint64_t)st.st_size)
+    {
+        munmap(addr, st.st_size);
+        return false;
+    }
+    mapping.data = (const uchar *)addr;
+    mapping.size = st.st_size;
+    for (uint64_t n = 0; n < header.numFrames; n++)
+        mapping.frames.push_back(Mat(header.height, header.width, header.type, (uchar *)addr + FRAME_CACHE_DATA_OFFSET + n * header.frameBytes));
+    return true;
+}
+
+bool cachedFrames(const String &videoFile, Size size, vector<Mat> &frames, FrameCacheHandle &handle)
+{
+    // a file is mapped once while handles to it are held, the frames handed out point into it
+    static map<String, weak_ptr<CacheMapping>> mappings;
+    static mutex mappingsLock;
+
+    if (!frameCacheEnabled())
+        return false;
+    FrameCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    if (!hashFile(videoFile, header.sourceHash))
+        return false;
+    if (size.empty())
+    {
+        VideoCapture cap(videoFile);
+        size = Size((int)cap.get(CAP_PROP_FRAME_WIDTH), (int)cap.get(CAP_PROP_FRAME_HEIGHT));
+        if (size.empty())
+            return false;
+    }
+    memcpy(header.magic, FRAME_CACHE_MAGIC, sizeof(header.magic));
+    header.version = FRAME_CACHE_VERSION;
+    header.width = size.width;
+    header.height = size.height;
+    header.type = CV_8UC3; // VideoCapture decodes to 8-bit BGR
+    String cacheFile = format("%s/%016llx-%dx%d-%d.frames", cacheDir.c_str(), (unsigned long long)header.sourceHash, size.width, size.height, header.type);
+
+    lock_guard<mutex> guard(mappingsLock);
+    shared_ptr<CacheMapping> mapping = mappings[cacheFile].lock();
+    if (!mapping)
+    {
+        mapping = make_shared<CacheMapping>();
+        if (!mapCache(cacheFile, header, *mapping))
+        {
+            cout << "Decoding " << videoFile << " into the frame cache " << cacheFile << endl;
+            if (!writeCache(videoFile, cacheFile, size, header) || !mapCache(cacheFile, header, *mapping))
+            {
+                cout << "Could not write the frame cache " << cacheFile << ", the video is decoded" << endl;
+                mappings.erase(cacheFile);
+                return false;
+            }
+        }
+        mappings[cacheFile] = mapping;
+    }
+    frames = mapping->frames;
+    handle = mapping;
+    return true;
+}
@@ -0,0 +1,63 @@
+/*
+****************************************
+* This file contains the declaration
+* of the decoded frame cache. Tuning
+* runs decode the same clip again and
+* again, the first run with the cache
+* decodes the whole clip once into a
+* raw file, later runs (of main and of
+* the quality tool) map that file and
+* use its frames without decoding or
+* copying them.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+/*
+* One file per input and geometry : FRAME_CACHE_DIR/<hash>-<width>x<height>-<type>.frames
+* The hash covers the size and modification time of the input and its first and last
+* FRAME_CACHE_HASH_BYTES, so an edited input gets a new file even if the edit is in the middle.
+* The geometry is the one of the output the frames are compared with or interpolated into, main
+* and the quality tool ask for the same one and share the file. Layout : FrameCacheHeader, padded to FRAME_CACHE_DATA_OFFSET,
+* then the frames as raw BGR rows, each frame starting on a page boundary. The file is written
+* to a ".tmp" name and renamed once complete.
+* A 1080p 8-bit frame takes 6 MB, the files are not removed automatically.
+* This file does not include constants.hpp so that the quality tool can build it.
+*/
+#ifndef FRAME_CACHE_HPP
+#define FRAME_CACHE_HPP
+
+#include <opencv2/core.hpp>
+#include <memory>
+#include <stdint.h>
+
+using namespace cv;
+using namespace std;
+
+#define FRAME_CACHE_MAGIC "BMCFRM01"
+#define FRAME_CACHE_VERSION 1
+#define FRAME_CACHE_DIR "frame-cache"
+#define FRAME_CACHE_HASH_BYTES (1 << 20)
+#define FRAME_CACHE_DATA_OFFSET 4096
+
+struct FrameCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    int32_t width, height, type; // geometry of the cached frames
+    uint64_t numFrames;
+    uint64_t frameBytes; // bytes between two frames, a multiple of the page size
+    uint64_t sourceHash;
+    double fps;
+};
+
+// keeps a cache file mapped, the file is unmapped when the last handle to it is released
+typedef shared_ptr<const void> FrameCacheHandle;
+
+void enableFrameCache(const String &dir = FRAME_CACHE_DIR);
+bool frameCacheEnabled();
+// the frames of videoFile at size (the size of the video if size is empty), decoded into the cache
+// if needed. The Mats point into the mapping and stay valid as long as handle (or a copy of it) is held
+bool cachedFrames(const String &videoFile, Size size, vector<Mat> &frames, FrameCacheHandle &handle);
+
+#endif
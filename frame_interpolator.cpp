@@ -0,0 +1,133 @@
+/*
+****************************************
+* This file contains the definitions of
+* the embeddable interpolator.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include "frame_interpolator.hpp"
+
+using namespace cv;
+using namespace std;
+
+bool applyConfig(BlockMatchingCorrelation &engine, const InterpolatorConfig &config, String &error)
+{
+    if (config.rateFactor < 2 || config.numPeaks < 1 || config.searchRange < 0)
+    {
+        error = "The rate factor must be at least 2, the peaks at least 1 and the search range positive";
+        return false;
+    }
+    if (!engine.setPreset(config.preset))
+    {
+        error = "Unknown preset " + config.preset;
+        return false;
+    }
+    if (!engine.setGlobalModel(config.globalMotion))
+    {
+        error = "Unknown global motion model " + config.globalMotion;
+        return false;
+    }
+    engine.setRateFactor(config.rateFactor);
+    engine.setNumPeaks(config.numPeaks);
+    engine.setIntegerME(config.integerME);
+    engine.setCPPCReuse(config.reuseCPPC);
+    engine.setQuadtree(config.quadtree);
+    engine.setSearchRange(config.searchRange);
+    return true;
+}
+
+FrameInterpolator::FrameInterpolator() : engine("")
+{
+    engine.setVerbose(false);
+    applyConfig(engine, config, error);
+}
+
+bool FrameInterpolator::configure(const InterpolatorConfig &newConfig)
+{
+    if (!applyConfig(engine, newConfig, error))
+        return false;
+    config = newConfig;
+    reset();
+    return true;
+}
+
+bool FrameInterpolator::push(const Mat &frame)
+{
+    /* the output of the pair (previous, frame) is queued : previous, then the rateFactor - 1 frames in between */
+    UMat current, scaled, interpolatedFrame;
+    if (frame.empty() || (frame.type() != CV_8UC3 && frame.type() != CV_16UC3))
+    {
+        error = "Frames must be CV_8UC3 or CV_16UC3";
+        return false;
+    }
+    if (!previous.empty() && (frame.size() != inputSize || frame.type() != previous.type()))
+    {
+        error = "The frame size or type changed within a stream, flush() first";
+        return false;
+    }
+    inputSize = frame.size();
+    frame.copyTo(current);
+    bool tiling = needsTiling(inputSize);
+    if (tiling && !tiled)
+        tiled.reset(new TiledInterpolator(engine));
+    // smaller inputs, or inputs of another shape, are estimated and compensated at the engine's frame size
+    if (!tiling && inputSize != Size(FRAME_WIDTH, FRAME_HEIGHT))
+        resize(current, scaled, Size(FRAME_WIDTH, FRAME_HEIGHT));
+    else
+        scaled = current;
+
+    if (!previous.empty())
+    {
+        if (tiling)
+            tiled->motionEstimation(previous, current);
+        else
+            engine.motionEstimation(previousScaled, scaled);
+        output.push_back(previous);
+        for (int k = 1; k < config.rateFactor; k++)
+        {
+            double t = (double)k / config.rateFactor;
+            if (tiling)
+            {
+                tiled->motionCompensation(previous, current, interpolatedFrame, t);
+            }
+            else
+            {
+                engine.motionCompensation(previousScaled, scaled, interpolatedFrame, t);
+                if (scaled.size() != inputSize)
+                    resize(interpolatedFrame, interpolatedFrame, inputSize);
+            }
+            output.push_back(interpolatedFrame.clone());
+        }
+    }
+    previous = current;
+    previousScaled = scaled;
+    return true;
+}
+
+bool FrameInterpolator::pull(Mat &frame)
+{
+    if (output.empty())
+        return false;
+    output.front().copyTo(frame);
+    output.pop_front();
+    return true;
+}
+
+void FrameInterpolator::flush()
+{
+    if (!previous.empty())
+        output.push_back(previous);
+    previous.release();
+    previousScaled.release();
+    // the next stream starts without the motion of this one
+    engine.setBlockMV(vector<vector<Point2f>>(NUM_BLOCKS_Y, vector<Point2f>(NUM_BLOCKS_X, Point2f(0, 0))));
+    tiled.reset();
+}
+
+void FrameInterpolator::reset()
+{
+    output.clear();
+    flush();
+    output.clear();
+}
@@ -0,0 +1,90 @@
+/*
+****************************************
+* This file contains the declaration
+* of the embeddable interpolator. A
+* media service pushes decoded frames
+* and pulls the output frames (the input
+* frames with the interpolated ones in
+* between), all buffers belong to the
+* caller. The pushed frames are
+* returned untouched, the interpolated
+* ones have the size of the input :
+* inputs larger than the engine's frame
+* size are tiled as in tiling.hpp, the
+* others are resized for the engine.
+* The settings come from an
+* InterpolatorConfig instead of the
+* command line, and nothing is printed,
+* errors are returned through
+* getError().
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+/*
+* To build the library (everything except main.cpp) :
+*   make -C benchmark libbmc
+* which runs
+*   g++ -O2 -Wall -fPIC -shared `ls *.cpp | grep -v main.cpp` -o libbmc.so `pkg-config --cflags --libs opencv4` -pthread
+* and link a service against it :
+*   g++ service.cpp -L. -lbmc -o service `pkg-config --cflags --libs opencv4`
+*
+* Usage :
+*   FrameInterpolator interpolator;
+*   InterpolatorConfig config;
+*   config.rateFactor = 4;
+*   if (!interpolator.configure(config)) ... interpolator.getError()
+*   while (decode(frame)) { interpolator.push(frame); while (interpolator.pull(out)) encode(out); }
+*   interpolator.flush(); while (interpolator.pull(out)) encode(out);
+*/
+#ifndef FRAME_INTERPOLATOR_HPP
+#define FRAME_INTERPOLATOR_HPP
+
+#include <opencv2/core.hpp>
+#include <deque>
+#include <memory>
+#include "bmc.hpp"
+#include "tiling.hpp"
+
+using namespace cv;
+using namespace std;
+
+struct InterpolatorConfig
+{
+    int rateFactor = 2;                   // output frames per input frame
+    int numPeaks = PHASE_CORR_PEAKS;      // motion vector candidates per CPPC region
+    String preset = DEFAULT_PRESET;       // see presets.hpp
+    bool integerME = INTEGER_ME;          // false for the float reference path
+    bool reuseCPPC = false;               // reuse the region vectors while the motion is stable
+    bool quadtree = false;                // variable block sizes
+    int searchRange = 0;                  // full-search refinement window, 0 to disable
+    String globalMotion = "off";          // off, translation, affine or homography
+};
+
+// applies config to engine, false with the reason in error if a value is invalid
+bool applyConfig(BlockMatchingCorrelation &engine, const InterpolatorConfig &config, String &error);
+
+class FrameInterpolator
+{
+    BlockMatchingCorrelation engine;
+    unique_ptr<TiledInterpolator> tiled; // for inputs larger than the engine's frame size
+    InterpolatorConfig config;
+    UMat previous;       // last pushed frame, as it was pushed
+    UMat previousScaled; // the same frame at the engine's frame size when it is resized
+    Size inputSize;      // size of the pushed frames, the output is returned at this size
+    deque<UMat> output;  // frames waiting to be pulled
+    String error;
+
+public:
+    FrameInterpolator();
+    bool configure(const InterpolatorConfig &config);
+    bool push(const Mat &frame); // the frame is copied, CV_8UC3 or CV_16UC3 BGR
+    bool pull(Mat &frame);       // false when no frame is ready, frame is reallocated only if its size or type differ
+    void flush();                // the last pushed frame becomes ready, the next push starts a new stream
+    void reset();                // drops the pending frames and the motion history
+    size_t pending() const { return output.size(); }
+    const String &getError() const { return error; }
+    const StageTimes &getStageTimes() const { return engine.getStageTimes(); }
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+****************************************
+* This file contains the definitions of
+* the frame server.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include "frame_server.hpp"
+#include "util.hpp"
+
+using namespace cv;
+using namespace std;
+
+FrameServer::FrameServer(const BlockMatchingCorrelation &settings, const String &inputVideo, size_t cachedFrames, size_t cachedFields)
+    : engine(""), inputVideo(inputVideo), nextDecode(-1), fps(0), frameCount(0),
+      frameCache(cachedFrames), fieldCache(cachedFields), estimatedPairs(0)
+{
+    engine.copySettings(settings);
+    engine.setVerbose(false);
+    engine.setCPPCReuse(false); // requests jump around the video, the previous region vectors may belong to another scene
+    if (isImageSequence(inputVideo))
+    {
+        error = "The frame server needs a video file, image sequences are not supported";
+        return;
+    }
+    cap.open(inputVideo);
+    if (!cap.isOpened())
+    {
+        error = "Error opening video stream or file " + inputVideo;
+        return;
+    }
+    fps = cap.get(CAP_PROP_FPS);
+    frameCount = fps > 0 ? (int)cap.get(CAP_PROP_FRAME_COUNT) : 0;
+    if (frameCount <= 0)
+        error = "The video does not report its frame rate and frame count, time stamps cannot be served";
+    nextDecode = 0;
+}
+
+bool FrameServer::decode(int n, UMat &frame)
+{
+    /* frame n from the cache, or decoded. The capture only seeks when n does not follow the last decoded frame */
+    UMat *cached = frameCache.get(n);
+    if (cached)
+    {
+        frame = *cached;
+        return true;
+    }
+    if (n != nextDecode && !seekFrame(cap, inputVideo, n))
+    {
+        nextDecode = -1;
+        return false;
+    }
+    if (!readFrame(cap, frame))
+    {
+        nextDecode = -1;
+        return false;
+    }
+    nextDecode = n + 1;
+    frameCache.put(n, frame);
+    return true;
+}
+
+bool FrameServer::pairField(int n, const UMat &prev, const UMat &curr, MVField &field)
+{
+    /* the MV field of the pair (n, n + 1). A pair whose previous pair is cached starts from that field
+       for its median candidates, otherwise from a zero field as the first pair of a video. The previous
+       pair is only looked at, it is not a request and does not count as a hit or a miss */
+    MVField *cached = fieldCache.get(n);
+    if (cached)
+    {
+        field = *cached;
+        return true;
+    }
+    MVField *previous = fieldCache.peek(n - 1);
+    if (previous)
+    {
+        engine.setMVField(*previous);
+    }
+    else
+    {
+        engine.getMVField(field);
+        for (auto &row : field.blockMV)
+            fill(row.begin(), row.end(), Point2f(0, 0));
+        engine.setBlockMV(field.blockMV);
+    }
+    engine.motionEstimation(prev, curr);
+    engine.getMVField(field);
+    fieldCache.put(n, field);
+    estimatedPairs++;
+    return true;
+}
+
+bool FrameServer::frameAt(double seconds, UMat &frame)
+{
+    /* the frame at seconds from the start of the video, interpolated between the two frames around it */
+    lock_guard<mutex> guard(serverLock);
+    if (!isOpen() || seconds < 0)
+        return false;
+    double position = seconds * fps;
+    int n = (int)floor(position);
+    double t = position - n;
+    if (n >= frameCount)
+        return false;
+
+    UMat prev, curr;
+    MVField field;
+    if (!decode(n, prev))
+        return false;
+    // a time stamp on a frame, or past the last frame, needs no interpolation
+    // a copy is returned, the caller may write into the frame or pass it back as an output buffer
+    if (t < FRAME_SERVER_SNAP || n + 1 >= frameCount || !decode(n + 1, curr))
+    {
+        frame = prev.clone();
+        return true;
+    }
+    if (1 - t < FRAME_SERVER_SNAP)
+    {
+        frame = curr.clone();
+        return true;
+    }
+    pairField(n, prev, curr, field);
+    engine.setMVField(field);
+    engine.motionCompensation(prev, curr, frame, t);
+    return true;
+}
+
+String FrameServer::getSummary() const
+{
+    lock_guard<mutex> guard(serverLock);
+    return format("Frame server : %zu of %zu frames from the cache, %zu of %zu MV field lookups from the cache, %zu pairs estimated",
+                  frameCache.hits, frameCache.hits + frameCache.misses, fieldCache.hits, fieldCache.hits + fieldCache.misses, estimatedPairs);
+}
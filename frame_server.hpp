@@ -0,0 +1,60 @@
+/*
+****************************************
+* This file contains the declaration
+* of the frame server. It returns the
+* frame at any time stamp of a video
+* (seek, scrub, variable-speed
+* playback) instead of interpolating the
+* whole video. Only the two frames
+* around the time stamp are decoded and
+* their pair is estimated once, recent
+* frames and MV fields are kept in LRU
+* caches so that repeated or nearby
+* requests skip decoding and motion
+* estimation. As the embeddable
+* interpolator it prints nothing, errors
+* are returned through getError().
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef FRAME_SERVER_HPP
+#define FRAME_SERVER_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <mutex>
+#include "bmc.hpp"
+#include "lru_cache.hpp"
+
+using namespace cv;
+using namespace std;
+
+class FrameServer
+{
+    BlockMatchingCorrelation engine;
+    String inputVideo;
+    VideoCapture cap;
+    int nextDecode; // frame the capture returns next, -1 when it has to seek
+    double fps;
+    int frameCount;
+    LRUCache<int, UMat> frameCache;    // decoded frames by number
+    LRUCache<int, MVField> fieldCache; // MV field of the pair (n, n + 1) by n
+    size_t estimatedPairs;
+    mutable mutex serverLock;
+    String error;
+
+    bool decode(int n, UMat &frame);
+    bool pairField(int n, const UMat &prev, const UMat &curr, MVField &field);
+
+public:
+    FrameServer(const BlockMatchingCorrelation &settings, const String &inputVideo,
+                size_t cachedFrames = FRAME_SERVER_FRAMES, size_t cachedFields = FRAME_SERVER_FIELDS);
+    bool isOpen() const { return frameCount > 0; }
+    double getDuration() const { return frameCount / fps; }
+    bool frameAt(double seconds, UMat &frame); // false if seconds lies outside the video
+    String getSummary() const; // cache hits and estimated pairs so far
+    const String &getError() const { return error; }
+};
+
+#endif
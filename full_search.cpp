@@ -0,0 +1,69 @@
+/*
+****************************************
+* This file contains the definitions of
+* the full-search refinement.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include "full_search.hpp"
+#include "util.hpp"
+
+using namespace cv;
+using namespace std;
+
+template <typename T>
+static int cornerSum(const Mat &integralImage, int x1, int y1, int x2, int y2)
+{
+    return (int)(integralImage.at<T>(y2, x2) - integralImage.at<T>(y1, x2) - integralImage.at<T>(y2, x1) + integralImage.at<T>(y1, x1));
+}
+
+int integralSum(const Mat &integralImage, Rect region)
+{
+    /* sum of the pixels of region from an integral image (CV_32S for 8-bit frames, CV_64F for 16-bit,
+       one row and column larger than the frame), the part of region outside the frame counts as 0 as in getPaddedROI */
+    region &= Rect(0, 0, integralImage.cols - 1, integralImage.rows - 1);
+    if (region.empty())
+        return 0;
+    int x1 = region.x, y1 = region.y, x2 = region.x + region.width, y2 = region.y + region.height;
+    if (integralImage.depth() == CV_64F)
+        return cornerSum<double>(integralImage, x1, y1, x2, y2);
+    return cornerSum<int>(integralImage, x1, y1, x2, y2);
+}
+
+void fullSearch(const Mat &prevBlock, int prevSum, Point pos, const Mat &currInt, const Mat &currIntegral, int range, Point &best, int &bestSAD, SearchStats &stats)
+{
+    /* searches the displacements best + (-range..range, -range..range) of the block of prev at pos,
+       best and bestSAD hold the winning candidate on entry and the refined match on return */
+    auto start = chrono::steady_clock::now();
+    Point center = best;
+    Size size = prevBlock.size();
+
+    for (int v = -range; v <= range; v++)
+    {
+        for (int u = -range; u <= range; u++)
+        {
+            Point d = center + Point(u, v);
+            Rect region(pos + d, size);
+            if (d == center || (region & Rect(0, 0, currInt.cols, currInt.rows)).empty())
+                continue; // the center is already scored, a block entirely outside the frame is never a match
+            stats.positions++;
+            // successive elimination : the SAD is at least the difference of the two block sums
+            if (abs(prevSum - integralSum(currIntegral, region)) >= bestSAD)
+            {
+                stats.pruned++;
+                continue;
+            }
+            int SAD = blockSADInt(prevBlock, getPaddedROI(currInt, region.x, region.y, size.width, size.height), bestSAD);
+            if (SAD < bestSAD)
+            {
+                bestSAD = SAD;
+                best = d;
+            }
+        }
+    }
+    stats.blocks++;
+    if (best != center)
+        stats.improved++;
+    stats.ms += msSince(start);
+}
@@ -0,0 +1,38 @@
+/*
+****************************************
+* This file contains the declaration
+* of the full-search refinement. Around
+* the best candidate of a block every
+* displacement of a square window is
+* considered, the successive
+* elimination algorithm rules most of
+* them out from block sums read off the
+* integral image of the frame before
+* any SAD is computed :
+*   |sum(prev block) - sum(curr block)| <= SAD
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef FULL_SEARCH_HPP
+#define FULL_SEARCH_HPP
+
+#include <opencv2/core.hpp>
+#include "constants.hpp"
+
+using namespace cv;
+using namespace std;
+
+struct SearchStats
+{
+    size_t blocks;    // blocks refined
+    size_t positions; // displacements considered
+    size_t pruned;    // displacements ruled out by their block sum
+    size_t improved;  // blocks whose vector changed
+    double ms;        // time spent refining
+};
+
+int integralSum(const Mat &integralImage, Rect region);
+void fullSearch(const Mat &prevBlock, int prevSum, Point pos, const Mat &currInt, const Mat &currIntegral, int range, Point &best, int &bestSAD, SearchStats &stats);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+****************************************
+* This file contains the definitions of
+* the global motion model.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <opencv2/calib3d.hpp>
+#include "global_motion.hpp"
+
+using namespace cv;
+using namespace std;
+
+bool getGlobalModel(const String &name, GlobalModel &model)
+{
+    if (name == "translation")
+        model = GLOBAL_TRANSLATION;
+    else if (name == "affine")
+        model = GLOBAL_AFFINE;
+    else if (name == "homography")
+        model = GLOBAL_HOMOGRAPHY;
+    else if (name == "off")
+        model = GLOBAL_OFF;
+    else
+        return false;
+    return true;
+}
+
+static int countInliers(const vector<Point2f> &src, const vector<Point2f> &dst, Point2f shift, vector<uchar> &inliers)
+{
+    int count = 0;
+    inliers.assign(src.size(), 0);
+    for (size_t k = 0; k < src.size(); k++)
+    {
+        if (norm(dst[k] - src[k] - shift) <= GLOBAL_MOTION_THRESHOLD)
+        {
+            inliers[k] = 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+bool fitGlobalModel(const vector<Point2f> &src, const vector<Point2f> &dst, GlobalModel model, Matx33d &H, double &inlierRatio)
+{
+    vector<uchar> inliers;
+    H = Matx33d::eye();
+    inlierRatio = 0;
+    if (src.size() < 4)
+        return false;
+
+    if (model == GLOBAL_TRANSLATION)
+    {
+        // one match fixes a translation, so every match is tried as the hypothesis
+        int bestCount = 0;
+        Point2f best;
+        for (size_t k = 0; k < src.size(); k++)
+        {
+            int count = countInliers(src, dst, dst[k] - src[k], inliers);
+            if (count > bestCount)
+            {
+                bestCount = count;
+                best = dst[k] - src[k];
+            }
+        }
+        // the shift is refined to the mean of its inliers
+        countInliers(src, dst, best, inliers);
+        Point2f mean(0, 0);
+        for (size_t k = 0; k < src.size(); k++)
+            if (inliers[k])
+                mean += dst[k] - src[k];
+        mean *= 1.0f / bestCount;
+        H(0, 2) = mean.x;
+        H(1, 2) = mean.y;
+    }
+    else if (model == GLOBAL_AFFINE)
+    {
+        Mat A = estimateAffine2D(src, dst, inliers, RANSAC, GLOBAL_MOTION_THRESHOLD);
+        if (A.empty())
+            return false;
+        for (int r = 0; r < 2; r++)
+            for (int c = 0; c < 3; c++)
+                H(r, c) = A.at<double>(r, c);
+    }
+    else if (model == GLOBAL_HOMOGRAPHY)
+    {
+        Mat P = findHomography(src, dst, RANSAC, GLOBAL_MOTION_THRESHOLD, inliers);
+        if (P.empty())
+            return false;
+        H = Matx33d((const double *)P.ptr());
+    }
+    else
+    {
+        return false;
+    }
+    inlierRatio = (double)countNonZero(inliers) / src.size();
+    return inlierRatio >= GLOBAL_MOTION_INLIERS;
+}
+
+Point2f globalVector(const Matx33d &H, Point2f p)
+{
+    // displacement of p under H
+    Vec3d q = H * Vec3d(p.x, p.y, 1.0);
+    return Point2f((float)(q[0] / q[2]) - p.x, (float)(q[1] / q[2]) - p.y);
+}
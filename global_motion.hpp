@@ -0,0 +1,46 @@
+/*
+****************************************
+* This file contains the declaration
+* of the global motion model. When the
+* CPPC vectors of the regions agree on
+* one translation, affine transform or
+* homography (a pan, zoom or rotation
+* of the camera), the frame is warped as
+* a whole and only the blocks that do
+* not follow the model are matched and
+* compensated one by one.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef GLOBAL_MOTION_HPP
+#define GLOBAL_MOTION_HPP
+
+#include <opencv2/core.hpp>
+#include "constants.hpp"
+
+using namespace cv;
+using namespace std;
+
+enum GlobalModel
+{
+    GLOBAL_OFF,
+    GLOBAL_TRANSLATION,
+    GLOBAL_AFFINE,
+    GLOBAL_HOMOGRAPHY
+};
+
+struct GlobalMotionStats
+{
+    size_t pairs;  // frame pairs the model was fitted on
+    size_t fitted; // pairs with a good fit
+    size_t blocks; // blocks that took the model vector
+    size_t outliers;
+};
+
+bool getGlobalModel(const String &name, GlobalModel &model);
+// fits model to the matches src -> dst with RANSAC, H maps a point of prev to curr
+bool fitGlobalModel(const vector<Point2f> &src, const vector<Point2f> &dst, GlobalModel model, Matx33d &H, double &inlierRatio);
+Point2f globalVector(const Matx33d &H, Point2f p);
+
+#endif
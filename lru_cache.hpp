@@ -0,0 +1,82 @@
+/*
+****************************************
+* This file contains a bounded cache
+* that evicts the least recently used
+* entry, used by the frame server for
+* decoded frames and MV fields.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef LRU_CACHE_HPP
+#define LRU_CACHE_HPP
+
+#include <list>
+#include <map>
+#include <utility>
+#include <stdexcept>
+#include <cstddef>
+
+using namespace std;
+
+template <typename Key, typename Value>
+class LRUCache
+{
+    size_t capacity;
+    list<pair<Key, Value>> entries; // most recently used first
+    map<Key, typename list<pair<Key, Value>>::iterator> index;
+
+public:
+    size_t hits, misses;
+
+    LRUCache(size_t capacity) : capacity(capacity), hits(0), misses(0)
+    {
+        // put() evicts before it inserts, an empty cache would have nothing to evict
+        if (capacity == 0)
+            throw invalid_argument("A cache needs room for at least one entry");
+    }
+
+    Value *get(const Key &key)
+    {
+        // the entry becomes the most recently used one, NULL if it is not cached
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            misses++;
+            return NULL;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return &it->second->second;
+    }
+
+    Value *peek(const Key &key)
+    {
+        // as get(), but neither counted nor made the most recently used one
+        auto it = index.find(key);
+        return it == index.end() ? NULL : &it->second->second;
+    }
+
+    Value &put(const Key &key, const Value &value)
+    {
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            entries.splice(entries.begin(), entries, it->second);
+            it->second->second = value;
+            return it->second->second;
+        }
+        if (entries.size() == capacity)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+        entries.emplace_front(key, value);
+        index[key] = entries.begin();
+        return entries.front().second;
+    }
+
+    size_t size() const { return entries.size(); }
+};
+
+#endif
@@ -6,6 +6,120 @@
 */
 
 #include "bmc.hpp"
+#include "batch.hpp"
+#include "realtime.hpp"
+#include "segments.hpp"
+#include "shard.hpp"
+#include "checkpoint.hpp"
+#include "frame_server.hpp"
+#include "frame_interpolator.hpp"
+#include "metrics.hpp"
+#include "frame_cache.hpp"
+
+void printHelp()
+{
+    cout << "Usage : ./main path-of-input-video [options]\n"
+         << "        ./main --batch manifest [options]\n"
+         << "        ./main --realtime input output [options]\n"
+         << "        ./main --worker socket-path input [options]\n"
+         << "The input may be an image sequence such as frames/%06d.png, 16-bit images keep their depth\n"
+         << "Options :\n"
+         << "  --save-mv file   write the motion vector field of every frame pair to file\n"
+         << "  --from-mv file   skip motion estimation and render from the vectors in file\n"
+         << "  --rate N         output N frames per input frame (default 2)\n"
+         << "  --peaks K        motion vector candidates per CPPC region (default " << PHASE_CORR_PEAKS << ")\n"
+         << "  --preset name    ultrafast, fast, balanced or quality (default " << DEFAULT_PRESET << ")\n"
+         << "  --float-me       convert the luma to float for motion estimation (slower reference path)\n"
+         << "  --reuse-cppc     reuse the CPPC region vectors while the motion is stable\n"
+         << "  --quadtree       merge blocks that move together into 64x64 and split badly matched ones down to " << QUADTREE_MIN_BLOCK << "x" << QUADTREE_MIN_BLOCK << "\n"
+         << "  --search-range R search all displacements within R pixels of the best candidate of a block\n"
+         << "  --global-motion m warp the frame with a translation, affine or homography model fitted to the CPPC\n"
+         << "                   vectors and match only the blocks that do not follow it\n"
+         << "  --dedup          skip repeated frames (upconverted or 3:2 pulldown sources) and interpolate over the gaps\n"
+         << "  --frame-cache    keep the decoded frames in " << FRAME_CACHE_DIR << "/ and map them on later runs of the same input\n"
+         << "  --pool           recycle buffers through a pooling allocator and write " << ALLOC_STATS_FILE << "\n"
+         << "  --perf           count cycles, instructions, LLC and branch misses per stage in " << PERF_STATS_FILE << "\n"
+         << "  --metrics path   serve progress, memory and stage timings on the Unix socket path (JSON or Prometheus text),\n"
+         << "                   in every mode but --worker and --frame-at\n"
+         << "  --start pos      first frame to interpolate, a frame number or a time stamp (15s, 1:05, 00:01:05.25)\n"
+         << "  --end pos        last frame to interpolate (default : the end of the video)\n"
+         << "  --checkpoint s   write the output in segments and save a checkpoint every s seconds\n"
+         << "  --resume         continue from " << CHECKPOINT_FILE << " (checkpoints every " << CHECKPOINT_INTERVAL << " s unless --checkpoint is given)\n"
+         << "  --chunks K       split the video into K chunks interpolated concurrently\n"
+         << "  --warmup N       pairs estimated before every chunk (default " << SEGMENT_WARMUP << ")\n"
+         << "  --check-seams    compare the frames after every chunk boundary (or the vectors after every\n"
+         << "                   shard task boundary with --workers) with a serial run\n"
+         << "  --workers N      estimate the vectors in N worker processes (--warmup applies to every task,\n"
+         << "                   not with --quadtree or --global-motion)\n"
+         << "  --frame-at s     write the frame at s seconds to " << FRAME_AT_IMAGE << " instead of the video (repeatable)\n"
+         << "Batch options (the manifest lists 'input output' per line) :\n"
+         << "  --jobs N             worker threads shared by all jobs (default : number of cores)\n"
+         << "  --memory-budget MB   memory of all running jobs (default " << BATCH_MEMORY_BUDGET << ")\n"
+         << "Realtime options (input and output may be pipes or FIFOs) :\n"
+         << "  --budget ms          time allowed for one frame pair (default : the input frame interval)\n";
+}
+
+static bool streamVideo(const String &input, const InterpolatorConfig &config)
+{
+    /* a run without the options that only the engine's interpolate() handles : the frames are pushed to the
+       embeddable interpolator as they are decoded, and the output is pulled and encoded as it is ready */
+    FrameInterpolator interpolator;
+    FrameStream stream;
+    VideoWriter interpolatedVideo;
+    UMat frame;
+    Mat out;
+    int pushed = 0;
+    double newFPS = config.rateFactor * getInputFPS(input);
+
+    if (!interpolator.configure(config))
+    {
+        cout << interpolator.getError() << endl;
+        return false;
+    }
+    if (!stream.open(input, 0, -1, true)) // the frames keep their size, the output has the size of the input
+    {
+        cout << "Error opening video stream or file" << endl;
+        return false;
+    }
+    rotateFile(EXEC_TIME_FILE, EXEC_TIME_MAX_BYTES, EXEC_TIME_KEEP);
+    ofstream execFile(EXEC_TIME_FILE, ios_base::app);
+    getMetrics().beginRun(input, getFrameCount(input) - 1);
+    auto pullFrames = [&]() {
+        while (interpolator.pull(out))
+        {
+            if (!interpolatedVideo.isOpened())
+                interpolatedVideo.open(INTERPOLATED_VIDEO, VideoWriter::fourcc('X', 'V', 'I', 'D'), newFPS, out.size());
+            interpolatedVideo << out;
+        }
+    };
+    while (stream.read(frame))
+    {
+        auto start = chrono::high_resolution_clock::now();
+        if (!interpolator.push(frame.getMat(ACCESS_READ)))
+        {
+            cout << interpolator.getError() << endl;
+            return false;
+        }
+        if (pushed++ > 0)
+        {
+            auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - start);
+            writeToFile(execFile, duration);
+            getMetrics().pairDone(pushed - 2, interpolator.getStageTimes(), (double)duration.count());
+        }
+        pullFrames();
+        frame = UMat(); // the next frame is decoded into its own buffer
+    }
+    if (pushed < 2)
+    {
+        cout << "The video has no frame pair" << endl;
+        return false;
+    }
+    interpolator.flush();
+    pullFrames();
+    interpolatedVideo.release();
+    cout << "...completed the new video\nRelative Path of output video :" << INTERPOLATED_VIDEO << endl;
+    return true;
+}
 
 int main(int argc, char **argv)
 {
@@ -15,7 +129,247 @@ int main(int argc, char **argv)
     }
     if (argc >= 2)
     {
-        BlockMatchingCorrelation bmcObj = BlockMatchingCorrelation(argv[1]);
+        if (String(argv[1]) == "help")
+        {
+            printHelp();
+            return 0;
+        }
+        String input = argv[1];
+        String output;
+        bool batch = input == "--batch";
+        bool realtime = input == "--realtime";
+        bool worker = input == "--worker";
+        int first = 2;
+        double budget = 0;
+        int chunks = 1, warmup = SEGMENT_WARMUP;
+        bool checkSeams = false;
+        String rangeStart, rangeEnd;
+        double checkpointInterval = 0;
+        bool resume = false;
+        bool engineOnly = isImageSequence(input); // options that only the engine's interpolate() handles
+        int numWorkers = 0;
+        vector<double> frameTimes; // --frame-at requests
+        vector<String> engineArgs; // options that the worker processes need as well
+        InterpolatorConfig config; // engine settings, applied once all options are read
+        String error;
+        int numThreads = max(1, (int)thread::hardware_concurrency());
+        size_t memoryBudget = BATCH_MEMORY_BUDGET;
+        if (batch)
+        {
+            if (argc < 3)
+            {
+                printHelp();
+                return -1;
+            }
+            input = argv[2];
+            first = 3;
+        }
+        if (realtime || worker)
+        {
+            if (argc < 4)
+            {
+                printHelp();
+                return -1;
+            }
+            input = argv[2];
+            output = argv[3];
+            first = 4;
+        }
+        BlockMatchingCorrelation bmcObj(batch || realtime || worker ? "" : input);
+        for (int i = first; i < argc; i++)
+        {
+            String option = argv[i];
+            if (option == "--rate" || option == "--peaks" || option == "--preset" || option == "--search-range")
+                engineArgs.insert(engineArgs.end(), {option, i + 1 < argc ? argv[i + 1] : ""});
+            else if (option == "--float-me" || option == "--reuse-cppc")
+                engineArgs.push_back(option);
+            if (option == "--save-mv" || option == "--from-mv" || option == "--dedup" || option == "--perf" || option == "--pool" ||
+                option == "--start" || option == "--end" || option == "--checkpoint" || option == "--resume")
+                engineOnly = true;
+            if (option == "--save-mv" && i + 1 < argc)
+            {
+                bmcObj.saveVectors(argv[++i]);
+            }
+            else if (option == "--from-mv" && i + 1 < argc)
+            {
+                if (!bmcObj.renderFromVectors(argv[++i]))
+                    return -1;
+            }
+            else if (option == "--rate" && i + 1 < argc)
+            {
+                config.rateFactor = max(2, atoi(argv[++i]));
+            }
+            else if (option == "--peaks" && i + 1 < argc)
+            {
+                config.numPeaks = max(1, atoi(argv[++i]));
+            }
+            else if (option == "--preset" && i + 1 < argc)
+            {
+                config.preset = argv[++i];
+            }
+            else if (option == "--float-me")
+            {
+                config.integerME = false;
+            }
+            else if (option == "--reuse-cppc")
+            {
+                config.reuseCPPC = true;
+            }
+            else if (option == "--quadtree")
+            {
+                config.quadtree = true;
+            }
+            else if (option == "--search-range" && i + 1 < argc)
+            {
+                config.searchRange = max(0, atoi(argv[++i]));
+            }
+            else if (option == "--global-motion" && i + 1 < argc)
+            {
+                config.globalMotion = argv[++i];
+            }
+            else if (option == "--dedup")
+            {
+                bmcObj.setDedup(true);
+            }
+            else if (option == "--metrics" && i + 1 < argc)
+            {
+                if (!getMetrics().serve(argv[++i]))
+                    return -1;
+            }
+            else if (option == "--frame-cache")
+            {
+                enableFrameCache();
+            }
+            else if (option == "--perf")
+            {
+                bmcObj.usePerfCounters();
+            }
+            else if (option == "--pool")
+            {
+                bmcObj.usePoolAllocator();
+            }
+            else if (option == "--jobs" && i + 1 < argc)
+            {
+                numThreads = max(1, atoi(argv[++i]));
+            }
+            else if (option == "--memory-budget" && i + 1 < argc)
+            {
+                memoryBudget = (size_t)max(1, atoi(argv[++i]));
+            }
+            else if (option == "--start" && i + 1 < argc)
+            {
+                rangeStart = argv[++i];
+            }
+            else if (option == "--end" && i + 1 < argc)
+            {
+                rangeEnd = argv[++i];
+            }
+            else if (option == "--checkpoint" && i + 1 < argc)
+            {
+                checkpointInterval = max(0.1, atof(argv[++i]));
+            }
+            else if (option == "--resume")
+            {
+                resume = true;
+            }
+            else if (option == "--chunks" && i + 1 < argc)
+            {
+                chunks = max(1, atoi(argv[++i]));
+            }
+            else if (option == "--warmup" && i + 1 < argc)
+            {
+                warmup = max(0, atoi(argv[++i]));
+            }
+            else if (option == "--workers" && i + 1 < argc)
+            {
+                numWorkers = max(1, atoi(argv[++i]));
+            }
+            else if (option == "--frame-at" && i + 1 < argc)
+            {
+                frameTimes.push_back(atof(argv[++i]));
+            }
+            else if (option == "--check-seams")
+            {
+                checkSeams = true;
+            }
+            else if (option == "--budget" && i + 1 < argc)
+            {
+                budget = max(0.0, atof(argv[++i]));
+            }
+            else
+            {
+                cout << "Unknown option " << option << endl;
+                printHelp();
+                return -1;
+            }
+        }
+        if (getMetrics().isServing() && (worker || !frameTimes.empty()))
+        {
+            // a worker is counted by its coordinator, and --frame-at interpolates single frames, not pairs
+            cout << "--metrics cannot be combined with --worker or --frame-at" << endl;
+            return -1;
+        }
+        if (numWorkers > 0 && (config.quadtree || config.globalMotion != "off"))
+        {
+            // the records of the workers carry the fixed 32x32 grid, the partition and the global model would be lost
+            cout << "--quadtree and --global-motion cannot be combined with --workers" << endl;
+            return -1;
+        }
+        if (!applyConfig(bmcObj, config, error))
+        {
+            cout << error << endl;
+            return -1;
+        }
+        if (batch)
+        {
+            BatchRunner runner(bmcObj, numThreads, memoryBudget);
+            return runner.run(input) ? 0 : -1;
+        }
+        if (realtime)
+        {
+            RealtimeInterpolator interpolator(bmcObj, budget);
+            return interpolator.run(input, output) ? 0 : -1;
+        }
+        bmcObj.setFrameRange(rangeStart, rangeEnd);
+        bmcObj.setCheckpoint(resume && checkpointInterval == 0 ? CHECKPOINT_INTERVAL : checkpointInterval);
+        bmcObj.setResume(resume);
+        if (!frameTimes.empty())
+        {
+            FrameServer server(bmcObj, input);
+            UMat frame;
+            if (!server.isOpen())
+            {
+                cout << server.getError() << endl;
+                return -1;
+            }
+            for (double seconds : frameTimes)
+            {
+                if (!server.frameAt(seconds, frame))
+                {
+                    cout << "There is no frame at " << seconds << " s, the video lasts " << server.getDuration() << " s" << endl;
+                    continue;
+                }
+                imwrite(format(FRAME_AT_IMAGE, seconds), frame);
+            }
+            cout << server.getSummary() << endl;
+            return 0;
+        }
+        if (worker)
+            return runShardWorker(bmcObj, input, output) ? 0 : -1; // input is the socket, output the video
+        if (numWorkers > 0)
+        {
+            ShardCoordinator coordinator(bmcObj, argv[0], engineArgs, numWorkers, warmup);
+            coordinator.setShardCheck(checkSeams);
+            return coordinator.run(input) ? 0 : -1;
+        }
+        if (chunks > 1)
+        {
+            SegmentRunner runner(bmcObj, chunks, warmup);
+            runner.setSeamCheck(checkSeams);
+            return runner.run(input) ? 0 : -1;
+        }
+        if (!engineOnly)
+            return streamVideo(input, config) ? 0 : -1;
         bmcObj.interpolate();
     }
     return 0;
@@ -23,7 +377,29 @@ int main(int argc, char **argv)
 /*
 To compile from terminal, execute the following commad :
 g++ *.cpp -o main `pkg-config --cflags --libs opencv4`
+To build the engine as a library (libbmc.so, push/pull interface without console output), see frame_interpolator.hpp.
+A run without --save-mv, --from-mv, --dedup, --perf, --pool, --start, --end, --checkpoint or --resume on a video
+goes through the same push/pull interface, the other runs through the engine's interpolate()
 
 Usage :
 ./main path-of-input-video
+./main path-of-input-video --save-mv vectors.mvf
+./main path-of-input-video --from-mv vectors.mvf --rate 4
+./main path-of-input-video --quadtree
+./main path-of-input-video --search-range 16 --preset balanced
+./main path-of-input-video --global-motion affine
+./main path-of-input-video --dedup
+./main path-of-input-video --frame-at 12.5 --frame-at 12.52 --frame-at 12.54
+./main "master/frame-%06d.png" --global-motion affine          (16-bit images are written to video/output-%06d.png)
+./main path-of-input-video --frame-cache --preset fast        (later runs with other options map the decoded frames)
+./main path-of-input-video --metrics /tmp/bmc.sock      (curl --unix-socket /tmp/bmc.sock http://localhost/metrics)
+./main path-of-input-video --start 1:05:10 --end 1:05:20
+./main path-of-input-video --checkpoint 5
+./main path-of-input-video --resume
+./main path-of-input-video --chunks 8 --warmup 4 --check-seams
+./main video/penguin.mp4 --chunks 4 --check-seams      (also checks that every chunk starts on the frame it seeked to)
+./main path-of-input-video --workers 4 --preset fast
+./main video/penguin_30_part1.mp4 --workers 2 --check-seams  (two workers, vectors compared with a serial run)
+./main --batch manifest.txt --jobs 8 --memory-budget 4096
+ffmpeg -i input.mp4 -f avi -c:v rawvideo - | ./main --realtime /dev/stdin video/output.avi --preset fast
 */
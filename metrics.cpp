@@ -0,0 +1,224 @@
+/*
+****************************************
+* This file contains the definitions of
+* the metrics endpoint.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fstream>
+#include "metrics.hpp"
+#include "shard.hpp"
+#include "util.hpp"
+
+using namespace cv;
+using namespace std;
+
+static size_t residentBytes()
+{
+    // second field of /proc/self/statm, in pages
+    size_t pages = 0, resident = 0;
+    ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void stopMetrics()
+{
+    getMetrics().stop();
+}
+
+bool Metrics::serve(const String &path)
+{
+    sockaddr_un addr;
+    struct stat st;
+    socketPath = path;
+    if (!socketAddress(socketPath, addr))
+    {
+        cout << "Could not serve the metrics on " << socketPath << endl;
+        return false;
+    }
+    // only a socket left behind by an earlier run is replaced, any other file at path is kept and
+    // so is the socket of a process that still accepts connections on it
+    if (lstat(socketPath.c_str(), &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            cout << socketPath << " exists and is not a socket, the metrics are not served" << endl;
+            return false;
+        }
+        int probeFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool stale = probeFd >= 0 && connect(probeFd, (sockaddr *)&addr, sizeof(addr)) != 0 && errno == ECONNREFUSED;
+        if (probeFd >= 0)
+            close(probeFd);
+        if (!stale)
+        {
+            cout << socketPath << " is in use by another process, the metrics are not served" << endl;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || ::bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, METRICS_BACKLOG) != 0)
+    {
+        cout << "Could not serve the metrics on " << socketPath << endl;
+        if (listenFd >= 0)
+            close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    running = true;
+    start = chrono::steady_clock::now();
+    // the thread is detached, the socket is removed when the process exits
+    thread(&Metrics::serveLoop, this).detach();
+    atexit(stopMetrics);
+    return true;
+}
+
+void Metrics::stop()
+{
+    if (!running.exchange(false))
+        return;
+    unlink(socketPath.c_str());
+}
+
+void Metrics::serveLoop()
+{
+    while (running)
+    {
+        pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0)
+            continue;
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0)
+            continue;
+
+        // one request line, a client that sends nothing gets the Prometheus text after the timeout
+        char request[256] = {0};
+        pollfd cfd = {fd, POLLIN, 0};
+        if (poll(&cfd, 1, METRICS_POLL_MS) > 0 && read(fd, request, sizeof(request) - 1) < 0)
+            request[0] = '\0';
+        String line(request);
+        bool http = line.compare(0, 4, "GET ") == 0;
+        bool json = http ? line.find("json") != String::npos : line.compare(0, 4, "json") == 0;
+
+        String body = snapshot(json);
+        String reply = http ? format("HTTP/1.0 200 OK\r\nContent-Type: %s\r\nContent-Length: %d\r\n\r\n",
+                                     json ? "application/json" : "text/plain; version=0.0.4", (int)body.size()) + body
+                            : body;
+        size_t sent = 0;
+        while (sent < reply.size())
+        {
+            ssize_t n = write(fd, reply.data() + sent, reply.size() - sent);
+            if (n <= 0)
+                break;
+            sent += n;
+        }
+        close(fd);
+    }
+    close(listenFd);
+    listenFd = -1;
+}
+
+void Metrics::beginRun(const String &inputVideo, int pairs)
+{
+    lock_guard<mutex> guard(metricsLock);
+    input = inputVideo;
+    totalPairs = pairs;
+    donePairs = 0;
+    start = chrono::steady_clock::now();
+    total = StageTimes();
+}
+
+void Metrics::pairDone(int frameNo, const StageTimes &times, double ms)
+{
+    if (!running)
+        return;
+    lock_guard<mutex> guard(metricsLock);
+    donePairs++;
+    currentFrame = frameNo;
+    last = times;
+    total.globalCPPC += times.globalCPPC;
+    total.localCPPC += times.localCPPC;
+    total.BM += times.BM;
+    total.MC += times.MC;
+    pairMs = ms;
+}
+
+void Metrics::pairsDone(int frameNo, int pairs)
+{
+    if (!running)
+        return;
+    lock_guard<mutex> guard(metricsLock);
+    donePairs += pairs;
+    currentFrame = frameNo;
+}
+
+String Metrics::snapshot(bool json) const
+{
+    /* formatted outside the interpolation loop, which only holds metricsLock to copy its counters */
+    unique_lock<mutex> guard(metricsLock);
+    String file = input;
+    int pairs = totalPairs, done = donePairs, frame = currentFrame;
+    StageTimes lastTimes = last, totalTimes = total;
+    double lastMs = pairMs, elapsed = msSince(start) / 1000;
+    guard.unlock();
+
+    double rate = elapsed > 0 ? done / elapsed : 0; // frame pairs per second
+    bool haveEta = rate > 0 && pairs > done; // the total is unknown for pipes, the ETA is left out then
+    double eta = haveEta ? (pairs - done) / rate : 0;
+    size_t memory = residentBytes();
+    const char *stages[] = {"global_cppc", "local_cppc", "bm", "mc"};
+    double lastStage[] = {lastTimes.globalCPPC, lastTimes.localCPPC, lastTimes.BM, lastTimes.MC};
+    double totalStage[] = {totalTimes.globalCPPC, totalTimes.localCPPC, totalTimes.BM, totalTimes.MC};
+
+    String out;
+    if (json)
+    {
+        for (auto &c : file)
+            if (c == '"' || c == '\\')
+                c = '_';
+        out = format("{\"input\":\"%s\",\"pairs_total\":%d,\"pairs_done\":%d,\"current_frame\":%d,\"elapsed_seconds\":%.3f,"
+                     "\"pairs_per_second\":%.3f,",
+                     file.c_str(), pairs, done, frame, elapsed, rate);
+        if (haveEta)
+            out += format("\"eta_seconds\":%.1f,", eta);
+        out += format("\"resident_bytes\":%zu,\"last_pair_ms\":%.3f,\"stages\":{", memory, lastMs);
+        for (int s = 0; s < 4; s++)
+            out += format("%s\"%s\":{\"last_ms\":%.3f,\"total_ms\":%.3f}", s ? "," : "", stages[s], lastStage[s], totalStage[s]);
+        out += "}}\n";
+        return out;
+    }
+    out = format("# TYPE bmc_pairs_total gauge\nbmc_pairs_total %d\n"
+                 "# TYPE bmc_pairs_done counter\nbmc_pairs_done %d\n"
+                 "# TYPE bmc_current_frame gauge\nbmc_current_frame %d\n"
+                 "# TYPE bmc_elapsed_seconds gauge\nbmc_elapsed_seconds %.3f\n"
+                 "# TYPE bmc_pairs_per_second gauge\nbmc_pairs_per_second %.3f\n",
+                 pairs, done, frame, elapsed, rate);
+    if (haveEta)
+        out += format("# TYPE bmc_eta_seconds gauge\nbmc_eta_seconds %.1f\n", eta);
+    out += format("# TYPE bmc_resident_bytes gauge\nbmc_resident_bytes %zu\n"
+                  "# TYPE bmc_last_pair_ms gauge\nbmc_last_pair_ms %.3f\n",
+                  memory, lastMs);
+    out += "# TYPE bmc_stage_last_ms gauge\n";
+    for (int s = 0; s < 4; s++)
+        out += format("bmc_stage_last_ms{stage=\"%s\"} %.3f\n", stages[s], lastStage[s]);
+    out += "# TYPE bmc_stage_ms_total counter\n";
+    for (int s = 0; s < 4; s++)
+        out += format("bmc_stage_ms_total{stage=\"%s\"} %.3f\n", stages[s], totalStage[s]);
+    return out;
+}
+
+Metrics &getMetrics()
+{
+    // never destroyed, the serving thread may still use it during exit
+    static Metrics *metrics = new Metrics();
+    return *metrics;
+}
@@ -0,0 +1,67 @@
+/*
+****************************************
+* This file contains the declaration
+* of the metrics endpoint. While a job
+* runs, a background thread serves a
+* snapshot of its progress (frame,
+* throughput, ETA), memory and stage
+* timings on a Unix domain socket. The
+* interpolation loop only copies its
+* counters once per frame pair, the
+* snapshot is formatted by the
+* background thread.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+/*
+* A client sends one request line and reads the snapshot until the socket is closed :
+*   "json"                      -> JSON
+*   anything else               -> Prometheus text format
+*   "GET /metrics HTTP/1.0"     -> the same over HTTP, "GET /json" for JSON
+* e.g. curl --unix-socket /tmp/bmc.sock http://localhost/metrics
+*      echo json | nc -U /tmp/bmc.sock
+* The ETA is left out while the number of frame pairs is unknown (pipes) or nothing has been done yet.
+*/
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "bmc.hpp"
+
+using namespace cv;
+using namespace std;
+
+class Metrics
+{
+    mutable mutex metricsLock;
+    String input;
+    int totalPairs, donePairs, currentFrame;
+    chrono::steady_clock::time_point start;
+    StageTimes last, total; // stage timings of the last pair and of all pairs, in ms
+    double pairMs;          // time of the last pair
+
+    String socketPath;
+    int listenFd;
+    atomic<bool> running;
+
+    void serveLoop();
+    String snapshot(bool json) const;
+
+public:
+    Metrics() : totalPairs(0), donePairs(0), currentFrame(0), last(), total(), pairMs(0), listenFd(-1), running(false) {}
+    bool serve(const String &socketPath); // starts the background thread
+    void stop();
+    bool isServing() const { return running; }
+    void beginRun(const String &inputVideo, int pairs);
+    void pairDone(int frameNo, const StageTimes &times, double ms);
+    void pairsDone(int frameNo, int pairs); // pairs estimated by other processes, without stage timings
+};
+
+Metrics &getMetrics();
+
+#endif
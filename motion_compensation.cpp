@@ -13,56 +13,104 @@
 using namespace cv;
 using namespace std;
 
-void bidirectionalMotionCompensation(const vector<vector<UMat>> &prevBlocks, const UMat &curr, const vector<vector<Point2f>> &prevBlocksMV, UMat &newFrame)
+static bool insideFrame(const Mat &frame, const Rect &r)
+{
+    // a block displaced completely out of the frame has nothing to sample
+    return r.x < frame.cols && r.x > -r.width && r.y < frame.rows && r.y > -r.height;
+}
+
+void interpolateBlock(const Mat &prev, const Mat &curr, const Rect &r, Point2f mv, double t, Mat &interpolatedRegion)
+{
+    /* the block moves along its vector, at time t it lies t * mv away from where it was in prev :
+       prev is sampled t * mv behind r and curr (1 - t) * mv ahead of it, then both are blended */
+    Point back((int)round(t * mv.x), (int)round(t * mv.y));
+    Point ahead = Point((int)round(mv.x), (int)round(mv.y)) - back; // back + ahead is the whole vector
+    Rect prevRect = r - back, currRect = r + ahead;
+    bool inPrev = insideFrame(prev, prevRect), inCurr = insideFrame(curr, currRect);
+
+    if (inPrev && inCurr)
+        addWeighted(getPaddedROI(prev, prevRect.x, prevRect.y, r.width, r.height), 1.0 - t,
+                    getPaddedROI(curr, currRect.x, currRect.y, r.width, r.height), t, 0.0, interpolatedRegion); // (1-t)*prev + t*curr
+    else if (inPrev)
+        interpolatedRegion = getPaddedROI(prev, prevRect.x, prevRect.y, r.width, r.height); // the block leaves the frame
+    else if (inCurr)
+        interpolatedRegion = getPaddedROI(curr, currRect.x, currRect.y, r.width, r.height); // the block enters the frame
+    else
+        interpolatedRegion = prev(r);
+}
+
+void compensateBlock(const Mat &prev, const Mat &curr, const Rect &r, Point2f mv, double t, Mat &frame)
+{
+    Mat interpolatedRegion;
+    interpolateBlock(prev, curr, r, mv, t, interpolatedRegion);
+    interpolatedRegion.copyTo(frame(r));
+}
+
+void bidirectionalMotionCompensation(const UMat &prev, const UMat &curr, const vector<vector<Point2f>> &prevBlocksMV, UMat &newFrame, double t)
 {
     // creates the interpolated frame using bidirectional motion compensation
-    UMat interpolatedRegion(Size(BLOCK_SIZE, BLOCK_SIZE), CV_8UC3), currRegion(Size(BLOCK_SIZE, BLOCK_SIZE), CV_8UC3);
-    int x, y;   // for accessing pixels in the x and y directions respectively
-    int dx, dy; // for accessing motion vector components
-    int i = 0,j = 0; // for accessing prevBlocks MVs
+    // t is the position of the new frame between prev (t = 0) and curr (t = 1)
+    Mat prevMat = prev.getMat(ACCESS_READ);
+    Mat currMat = curr.getMat(ACCESS_READ);
+    Mat frame = Mat::zeros(currMat.size(), currMat.type()); // 8 or 16 bits per channel as the input
 
-    //newFrame = UMat::zeros(Size(FRAME_WIDTH * 2, FRAME_HEIGHT * 2), CV_8UC3); // create an empty frame initially
-	//UMat frame = UMat::zeros(Size(FRAME_WIDTH, FRAME_HEIGHT), CV_8UC3);
-	// adding 10% padding to the newFrame
-    //copyMakeBorder( frame, newFrame, BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE, BORDER_CONSTANT);
-    newFrame = UMat::zeros(Size(FRAME_WIDTH, FRAME_HEIGHT), CV_8UC3); // create an empty frame initially
-    
-    for ( y = 0; y < curr.rows - BLOCK_SIZE; y += BLOCK_SIZE)
+    // the last row is aligned to the bottom of the frame, it overlaps the row above and is written last
+    for (int i = 0; i < NUM_BLOCKS_Y; i++)
     {
-    	j = 0;
-        for ( x = 0; x < curr.cols; x += BLOCK_SIZE)
+        int y = min(i * BLOCK_SIZE, currMat.rows - BLOCK_SIZE);
+        for (int j = 0; j < NUM_BLOCKS_X; j++)
+            compensateBlock(prevMat, currMat, Rect(j * BLOCK_SIZE, y, BLOCK_SIZE, BLOCK_SIZE), prevBlocksMV[i][j], t, frame);
+    }
+    frame.copyTo(newFrame);
+}
+
+static void compensateNodes(const Mat &prevMat, const Mat &currMat, const vector<QTBlock> &nodes, Mat &frame, double t)
+{
+    // same as bidirectionalMotionCompensation for nodes of any size,
+    // the nodes are written in order so that the last block row comes last
+    for (auto &node : nodes)
+        compensateBlock(prevMat, currMat, node.rect, node.mv, t, frame);
+}
+
+void variableMotionCompensation(const UMat &prev, const UMat &curr, const vector<QTBlock> &partition, UMat &newFrame, double t)
+{
+    // the frame is built from the nodes of a quadtree partition
+    Mat prevMat = prev.getMat(ACCESS_READ);
+    Mat currMat = curr.getMat(ACCESS_READ);
+    Mat frame = Mat::zeros(prevMat.size(), prevMat.type());
+
+    compensateNodes(prevMat, currMat, partition, frame, t);
+    frame.copyTo(newFrame);
+}
+
+void globalMotionCompensation(const UMat &prev, const UMat &curr, const Matx33d &H, const vector<QTBlock> &outliers, UMat &newFrame, double t)
+{
+    // every pixel moves along the vector that H gives at its position : prev is sampled t * v behind it and
+    // curr (1 - t) * v ahead of it, both are blended in one pass over the frame,
+    // the blocks that do not follow the model are compensated on top
+    Mat prevMat = prev.getMat(ACCESS_READ);
+    Mat currMat = curr.getMat(ACCESS_READ);
+    Mat prevMap(prevMat.size(), CV_32FC2), currMap(prevMat.size(), CV_32FC2);
+    Mat prevWarped, currWarped, frame;
+
+    parallel_for_(Range(0, prevMat.rows), [&](const Range &range) {
+        for (int y = range.start; y < range.end; y++)
         {
-            // for each block in prevBlock, determine the block in the next frame
-            // currRegion has the block corresponding to prevRegions[i][j]
-            dx = (int)round(prevBlocksMV[i][j].x);
-            dy = (int)round(prevBlocksMV[i][j].y);
-            if ( !(x + dx >= curr.cols || x + dx <= -1*BLOCK_SIZE || y + dy >= curr.rows || y + dy <= -1*BLOCK_SIZE) )
+            Point2f *prevRow = prevMap.ptr<Point2f>(y);
+            Point2f *currRow = currMap.ptr<Point2f>(y);
+            for (int x = 0; x < prevMat.cols; x++)
             {
-            	currRegion = getPaddedROI(curr, x + dx, y + dy, BLOCK_SIZE, BLOCK_SIZE);
+                Point2f p((float)x, (float)y);
+                Point2f v = globalVector(H, p);
+                prevRow[x] = p - (float)t * v;
+                currRow[x] = p + (float)(1.0 - t) * v;
             }
-            // determining the interpolateRegion and interpolatedFrame
-            addWeighted(prevBlocks[i][j], 0.5, currRegion, 0.5, 0.0, interpolatedRegion); // interpolatedRegion = 0.5*prevBlocks[i][j] + 0.5*currRegion
-            interpolatedRegion.copyTo(newFrame(Rect(x, y, BLOCK_SIZE, BLOCK_SIZE)));
-            j++;
         }
-        i++;
-    }
-    j = 0;
-    i = NUM_BLOCKS_Y - 1;
-    y = curr.rows - BLOCK_SIZE;
-    for ( x = 0; x < curr.cols; x += BLOCK_SIZE)
-    {
-    		dx = (int)round(prevBlocksMV[i][j].x);
-            dy = (int)round(prevBlocksMV[i][j].y);
-			if ( !(x + dx >= curr.cols || x + dx <= -1*BLOCK_SIZE || y + dy >= curr.rows || y + dy <= -1*BLOCK_SIZE))
-            {
-            	currRegion = getPaddedROI(curr, x + dx, y + dy, BLOCK_SIZE, BLOCK_SIZE);
-            }
-            // determining the interpolateRegion and interpolatedFrame
-            addWeighted(prevBlocks[i][j], 0.5, currRegion, 0.5, 0.0, interpolatedRegion); // interpolatedRegion = 0.5*prevBlocks[i][j] + 0.5*currRegion
-            interpolatedRegion.copyTo(newFrame(Rect(x, y, BLOCK_SIZE, BLOCK_SIZE)));
-            j++;
-    }
-    //cout<<"Frame size :"<<newFrame.rows<<","<<newFrame.cols<<endl;
-    //newFrame = newFrame(Rect(0, 0, FRAME_WIDTH, FRAME_HEIGHT));
+    });
+    remap(prevMat, prevWarped, prevMap, noArray(), INTER_LINEAR, BORDER_CONSTANT);
+    remap(currMat, currWarped, currMap, noArray(), INTER_LINEAR, BORDER_CONSTANT);
+    addWeighted(prevWarped, 1.0 - t, currWarped, t, 0.0, frame);
+
+    compensateNodes(prevMat, currMat, outliers, frame, t);
+    frame.copyTo(newFrame);
 }
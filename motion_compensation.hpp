@@ -12,10 +12,18 @@
 #include "opencv2/videoio.hpp"
 #include "opencv2/highgui.hpp"
 #include "opencv2/imgproc.hpp"
+#include "quadtree.hpp"
+#include "global_motion.hpp"
 
 using namespace cv;
 using namespace std;
 
-void bidirectionalMotionCompensation(const vector<vector<UMat>> &prevBlocks, const UMat &curr, const vector<vector<Point2f>> &prevBlocksMV, UMat &newFrame);
+// the block r of the frame at time t, blended from prev and curr along its vector mv (prev to curr)
+void interpolateBlock(const Mat &prev, const Mat &curr, const Rect &r, Point2f mv, double t, Mat &interpolatedRegion);
+// interpolateBlock written into frame(r)
+void compensateBlock(const Mat &prev, const Mat &curr, const Rect &r, Point2f mv, double t, Mat &frame);
+void bidirectionalMotionCompensation(const UMat &prev, const UMat &curr, const vector<vector<Point2f>> &prevBlocksMV, UMat &newFrame, double t = 0.5);
+void globalMotionCompensation(const UMat &prev, const UMat &curr, const Matx33d &H, const vector<QTBlock> &outliers, UMat &newFrame, double t = 0.5);
+void variableMotionCompensation(const UMat &prev, const UMat &curr, const vector<QTBlock> &partition, UMat &newFrame, double t = 0.5);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,211 @@
+/*
+****************************************
+* This file contains the definitions of
+* the motion vector sidecar reader and
+* writer.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+#include "mv_sidecar.hpp"
+
+using namespace cv;
+using namespace std;
+
+size_t mvRecordFloats(int numPeaks)
+{
+    size_t blockFloats = (size_t)NUM_BLOCKS_Y * NUM_BLOCKS_X * 3;
+    size_t regionFloats = (size_t)(NUM_GR_Y * NUM_GR_X + NUM_LR_Y * NUM_LR_X) * (2 * numPeaks + 1);
+    return blockFloats + regionFloats;
+}
+
+static void putRegions(vector<float> &record, const vector<vector<vector<Point2f>>> &regionMV, const vector<vector<double>> &response, int numPeaks)
+{
+    for (size_t i = 0; i < regionMV.size(); i++)
+    {
+        for (size_t j = 0; j < regionMV[i].size(); j++)
+        {
+            for (int k = 0; k < numPeaks; k++)
+            {
+                record.push_back(regionMV[i][j][k].x);
+                record.push_back(regionMV[i][j][k].y);
+            }
+            record.push_back((float)response[i][j]);
+        }
+    }
+}
+
+static const float *getRegions(const float *data, int rows, int cols, int numPeaks, vector<vector<vector<Point2f>>> &regionMV, vector<vector<double>> &response)
+{
+    regionMV.assign(rows, vector<vector<Point2f>>(cols, vector<Point2f>(numPeaks)));
+    response.assign(rows, vector<double>(cols, 0.0));
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            for (int k = 0; k < numPeaks; k++)
+            {
+                regionMV[i][j][k] = Point2f(data[0], data[1]);
+                data += 2;
+            }
+            response[i][j] = *data++;
+        }
+    }
+    return data;
+}
+
+bool MVSidecarWriter::open(const String &fileName, int numPeaks, int firstPair)
+{
+    close();
+    file.open(fileName, ios_base::binary | ios_base::trunc);
+    if (!file)
+    {
+        cout << "Could not open the motion vector file " << fileName << endl;
+        return false;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MV_SIDECAR_MAGIC, sizeof(header.magic));
+    header.version = MV_SIDECAR_VERSION;
+    header.numBlocksX = NUM_BLOCKS_X;
+    header.numBlocksY = NUM_BLOCKS_Y;
+    header.numGRX = NUM_GR_X;
+    header.numGRY = NUM_GR_Y;
+    header.numLRX = NUM_LR_X;
+    header.numLRY = NUM_LR_Y;
+    header.numPeaks = numPeaks;
+    header.recordSize = (uint32_t)(mvRecordFloats(numPeaks) * sizeof(float));
+    header.firstPair = firstPair;
+    header.numRecords = 0;
+    // the record count is patched in by close()
+    file.write((const char *)&header, sizeof(header));
+    return true;
+}
+
+void packMVField(const MVField &field, int numPeaks, vector<float> &record)
+{
+    record.clear();
+    record.reserve(mvRecordFloats(numPeaks));
+
+    for (int i = 0; i < NUM_BLOCKS_Y; i++)
+    {
+        for (int j = 0; j < NUM_BLOCKS_X; j++)
+        {
+            record.push_back(field.blockMV[i][j].x);
+            record.push_back(field.blockMV[i][j].y);
+            record.push_back((float)field.blockSAD[i][j]); // the records are floats, exact up to 2^24
+        }
+    }
+    putRegions(record, field.globalRegionMV, field.globalRegionResponse, numPeaks);
+    putRegions(record, field.localRegionMV, field.localRegionResponse, numPeaks);
+}
+
+void unpackMVField(const float *data, int numPeaks, MVField &field)
+{
+    field.blockMV.assign(NUM_BLOCKS_Y, vector<Point2f>(NUM_BLOCKS_X));
+    field.blockSAD.assign(NUM_BLOCKS_Y, vector<int>(NUM_BLOCKS_X));
+    for (int i = 0; i < NUM_BLOCKS_Y; i++)
+    {
+        for (int j = 0; j < NUM_BLOCKS_X; j++)
+        {
+            field.blockMV[i][j] = Point2f(data[0], data[1]);
+            field.blockSAD[i][j] = (int)data[2];
+            data += 3;
+        }
+    }
+    data = getRegions(data, NUM_GR_Y, NUM_GR_X, numPeaks, field.globalRegionMV, field.globalRegionResponse);
+    getRegions(data, NUM_LR_Y, NUM_LR_X, numPeaks, field.localRegionMV, field.localRegionResponse);
+}
+
+void MVSidecarWriter::write(const MVField &field)
+{
+    vector<float> record;
+    packMVField(field, header.numPeaks, record);
+
+    CV_Assert(record.size() * sizeof(float) == header.recordSize);
+    file.write((const char *)record.data(), header.recordSize);
+    header.numRecords++;
+}
+
+void MVSidecarWriter::close()
+{
+    if (!file.is_open())
+        return;
+    file.seekp(0);
+    file.write((const char *)&header, sizeof(header));
+    file.close();
+}
+
+bool MVSidecarReader::open(const String &fileName)
+{
+    struct stat st;
+    int fd;
+
+    close();
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        cout << "Could not open the motion vector file " << fileName << endl;
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MVSidecarHeader))
+    {
+        cout << "Invalid motion vector file " << fileName << endl;
+        ::close(fd);
+        return false;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping stays valid after the descriptor is closed
+    if (addr == MAP_FAILED)
+    {
+        cout << "Could not map the motion vector file " << fileName << endl;
+        return false;
+    }
+    mapped = (const uchar *)addr;
+    mappedSize = st.st_size;
+    memcpy(&header, mapped, sizeof(header));
+
+    // the file must have been written for the same frame geometry
+    if (memcmp(header.magic, MV_SIDECAR_MAGIC, sizeof(header.magic)) != 0 || header.version != MV_SIDECAR_VERSION ||
+        header.numBlocksX != NUM_BLOCKS_X || header.numBlocksY != NUM_BLOCKS_Y ||
+        header.numGRX != NUM_GR_X || header.numGRY != NUM_GR_Y ||
+        header.numLRX != NUM_LR_X || header.numLRY != NUM_LR_Y ||
+        header.recordSize != mvRecordFloats(header.numPeaks) * sizeof(float) ||
+        sizeof(header) + header.numRecords * header.recordSize > mappedSize)
+    {
+        cout << "Motion vector file " << fileName << " does not match this build" << endl;
+        close();
+        return false;
+    }
+    // the writer patches the record count into the header when it closes the file
+    if (header.numRecords == 0)
+    {
+        cout << "Motion vector file " << fileName << " has no frame pairs, the run that wrote it did not finish" << endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MVSidecarReader::read(size_t index, MVField &field) const
+{
+    if (index < first() || index - first() >= size())
+        return false;
+
+    const float *data = (const float *)(mapped + sizeof(header) + (index - first()) * header.recordSize);
+    unpackMVField(data, header.numPeaks, field);
+    return true;
+}
+
+void MVSidecarReader::close()
+{
+    if (mapped)
+        munmap((void *)mapped, mappedSize);
+    mapped = NULL;
+    mappedSize = 0;
+}
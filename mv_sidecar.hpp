@@ -0,0 +1,103 @@
+/*
+****************************************
+* This file contains the declaration
+* of the motion vector sidecar, a
+* binary file that stores the motion
+* vector field of every frame pair so
+* that it can be re-rendered without
+* running motion estimation again.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+/*
+* File layout (all values little endian) :
+*   MVSidecarHeader
+*   record 0 -> frame pair (firstPair, firstPair + 1)
+*   record 1 -> frame pair (firstPair + 1, firstPair + 2)
+*   ...
+* firstPair is the first frame of the span the file was written for (--start), 0 otherwise.
+* Every record has the same size, so record n starts at
+* sizeof(MVSidecarHeader) + n * recordSize and the file can be memory-mapped.
+* A record holds, as float32 :
+*   a) block MVs      : NUM_BLOCKS_Y x NUM_BLOCKS_X x (dx, dy, minimum SAD)
+*   b) global regions : NUM_GR_Y x NUM_GR_X x (numPeaks x (dx, dy), peak response)
+*   c) local regions  : NUM_LR_Y x NUM_LR_X x (numPeaks x (dx, dy), peak response)
+*/
+#ifndef MV_SIDECAR_HPP
+#define MV_SIDECAR_HPP
+
+#include <opencv2/core.hpp>
+#include <fstream>
+#include <stdint.h>
+#include "constants.hpp"
+
+using namespace cv;
+using namespace std;
+
+#define MV_SIDECAR_MAGIC "BMCMVF01"
+#define MV_SIDECAR_VERSION 2
+
+struct MVSidecarHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numBlocksX, numBlocksY;
+    uint32_t numGRX, numGRY;
+    uint32_t numLRX, numLRY;
+    uint32_t numPeaks;
+    uint32_t recordSize; // in bytes
+    uint32_t firstPair;  // the input frame pair of record 0
+    uint64_t numRecords;
+};
+
+// the motion vector field of one frame pair
+struct MVField
+{
+    vector<vector<Point2f>> blockMV;
+    vector<vector<int>> blockSAD;
+    vector<vector<vector<Point2f>>> globalRegionMV;
+    vector<vector<double>> globalRegionResponse;
+    vector<vector<vector<Point2f>>> localRegionMV;
+    vector<vector<double>> localRegionResponse;
+};
+
+size_t mvRecordFloats(int numPeaks);
+// a record in the layout above, also used to send vector fields between processes
+void packMVField(const MVField &field, int numPeaks, vector<float> &record);
+void unpackMVField(const float *data, int numPeaks, MVField &field);
+
+class MVSidecarWriter
+{
+    ofstream file;
+    MVSidecarHeader header;
+
+public:
+    bool open(const String &fileName, int numPeaks, int firstPair = 0);
+    void write(const MVField &field);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+    ~MVSidecarWriter() { close(); }
+};
+
+class MVSidecarReader
+{
+    const uchar *mapped; // the whole file, memory-mapped read only
+    size_t mappedSize;
+    MVSidecarHeader header;
+
+public:
+    MVSidecarReader() : mapped(NULL), mappedSize(0) {}
+    MVSidecarReader(const MVSidecarReader &) = delete; // owns the mapping
+    MVSidecarReader &operator=(const MVSidecarReader &) = delete;
+    bool open(const String &fileName);
+    // index is the input frame pair, not the record
+    bool read(size_t index, MVField &field) const;
+    size_t size() const { return mapped ? header.numRecords : 0; }
+    size_t first() const { return mapped ? header.firstPair : 0; }
+    bool isOpen() const { return mapped != NULL; }
+    void close();
+    ~MVSidecarReader() { close(); }
+};
+
+#endif
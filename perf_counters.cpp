@@ -0,0 +1,220 @@
+/*
+****************************************
+* This file contains the definitions of
+* the hardware performance counters.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+#include "perf_counters.hpp"
+
+using namespace std;
+
+static const char *stageNames[NUM_ALLOC_STAGES] = {"Other", "CPPC", "BM", "MC"};
+static const char *eventNames[NUM_PERF_EVENTS] = {"cycles", "instructions", "LLC misses", "branch misses"};
+static const uint32_t eventTypes[NUM_PERF_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+static const uint64_t eventConfigs[NUM_PERF_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                       PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+// every thread counts itself, the stages of a frame pair run on one thread
+// but the modes that run several engines do so on several threads
+struct ThreadCounters
+{
+    int fd[NUM_PERF_EVENTS];
+    uint64_t start[NUM_PERF_EVENTS];
+    int stage; // stage begun and not yet ended, -1 if none
+    bool opened;
+
+    ThreadCounters() : stage(-1), opened(false)
+    {
+        for (int e = 0; e < NUM_PERF_EVENTS; e++)
+            fd[e] = -1;
+    }
+    ~ThreadCounters()
+    {
+        for (int e = 0; e < NUM_PERF_EVENTS; e++)
+            if (fd[e] >= 0)
+                close(fd[e]);
+    }
+};
+static thread_local ThreadCounters threadCounters;
+
+static int openEvent(int e)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = eventTypes[e];
+    attr.config = eventConfigs[e];
+    attr.exclude_kernel = 1; // allowed with perf_event_paranoid up to 2
+    attr.exclude_hv = 1;
+    // this thread, on any CPU
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t readEvent(int fd)
+{
+    uint64_t value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+        return 0;
+    return value;
+}
+
+PerfCounters::PerfCounters() : unpaired(0), enabled(false)
+{
+    memset(frameStats, 0, sizeof(frameStats));
+    memset(runStats, 0, sizeof(runStats));
+    memset(available, 0, sizeof(available));
+}
+
+bool PerfCounters::enable()
+{
+    // probe every event once, the ones that cannot be opened are left out
+    int count = 0;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++)
+    {
+        int fd = openEvent(e);
+        available[e] = fd >= 0;
+        if (fd >= 0)
+        {
+            close(fd);
+            count++;
+        }
+    }
+    enabled = count > 0;
+    if (!enabled)
+        cout << "Hardware performance counters are not available, " << PERF_STATS_FILE << " is not written" << endl;
+    else if (count < NUM_PERF_EVENTS)
+        for (int e = 0; e < NUM_PERF_EVENTS; e++)
+            if (!available[e])
+                cout << "The " << eventNames[e] << " counter is not available" << endl;
+    return enabled;
+}
+
+void PerfCounters::begin(AllocStage stage)
+{
+    if (!enabled)
+        return;
+    ThreadCounters &tc = threadCounters;
+    if (!tc.opened)
+    {
+        for (int e = 0; e < NUM_PERF_EVENTS; e++)
+            tc.fd[e] = available[e] ? openEvent(e) : -1;
+        tc.opened = true;
+    }
+    if (tc.stage >= 0)
+    {
+        // stages do not nest, the stage left open is dropped
+        lock_guard<mutex> guard(statsLock);
+        unpaired++;
+    }
+    tc.stage = stage;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++)
+        tc.start[e] = readEvent(tc.fd[e]);
+}
+
+void PerfCounters::end(AllocStage stage)
+{
+    if (!enabled)
+        return;
+    ThreadCounters &tc = threadCounters;
+    uint64_t delta[NUM_PERF_EVENTS];
+    for (int e = 0; e < NUM_PERF_EVENTS; e++)
+        delta[e] = readEvent(tc.fd[e]) - tc.start[e];
+
+    lock_guard<mutex> guard(statsLock);
+    if (tc.stage != stage)
+    {
+        // an end without the begin of the same stage would attribute the counts to the wrong stage
+        unpaired++;
+        tc.stage = -1;
+        return;
+    }
+    tc.stage = -1;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++)
+    {
+        frameStats[stage].count[e] += delta[e];
+        runStats[stage].count[e] += delta[e];
+    }
+    frameStats[stage].calls++;
+    runStats[stage].calls++;
+}
+
+void PerfCounters::beginFrame()
+{
+    lock_guard<mutex> guard(statsLock);
+    memset(frameStats, 0, sizeof(frameStats));
+}
+
+static void writeStats(ofstream &file, const PerfStats *stats, const bool *available)
+{
+    for (int s = 0; s < NUM_ALLOC_STAGES; s++)
+    {
+        if (stats[s].calls == 0)
+            continue;
+        file << " | " << stageNames[s];
+        for (int e = 0; e < NUM_PERF_EVENTS; e++)
+            if (available[e])
+                file << " " << stats[s].count[e];
+        // instructions per cycle, and misses per thousand instructions
+        double instructions = (double)max<uint64_t>(1, stats[s].count[EVENT_INSTRUCTIONS]);
+        if (available[EVENT_CYCLES] && available[EVENT_INSTRUCTIONS])
+            file << " IPC " << instructions / max<uint64_t>(1, stats[s].count[EVENT_CYCLES]);
+        if (available[EVENT_LLC_MISSES] && available[EVENT_INSTRUCTIONS])
+            file << " LLC-MPKI " << 1000.0 * stats[s].count[EVENT_LLC_MISSES] / instructions;
+        if (available[EVENT_BRANCH_MISSES] && available[EVENT_INSTRUCTIONS])
+            file << " BR-MPKI " << 1000.0 * stats[s].count[EVENT_BRANCH_MISSES] / instructions;
+    }
+    file << "\n";
+}
+
+void PerfCounters::writeLegend(ofstream &file) const
+{
+    file << "Per stage values are";
+    for (int e = 0; e < NUM_PERF_EVENTS; e++)
+        if (available[e])
+            file << " " << eventNames[e] << ",";
+    file << " then the derived ratios\n";
+}
+
+void PerfCounters::writeFrameStats(ofstream &file, int frameNo) const
+{
+    if (!enabled)
+        return;
+    if (!file)
+    {
+        cout << "Could not open the file\n";
+        exit(-1);
+    }
+    lock_guard<mutex> guard(statsLock);
+    file << "Frame " << frameNo;
+    writeStats(file, frameStats, available);
+}
+
+void PerfCounters::writeRunStats(ofstream &file) const
+{
+    if (!enabled)
+        return;
+    if (!file)
+    {
+        cout << "Could not open the file\n";
+        exit(-1);
+    }
+    lock_guard<mutex> guard(statsLock);
+    file << "Run";
+    writeStats(file, runStats, available);
+    if (unpaired > 0)
+        file << unpaired << " stage measurements were dropped, their begin and end did not match\n";
+}
+
+PerfCounters &getPerfCounters()
+{
+    static PerfCounters counters;
+    return counters;
+}
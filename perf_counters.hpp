@@ -0,0 +1,66 @@
+/*
+****************************************
+* This file contains the declaration
+* of the hardware performance counters
+* collected around every stage of the
+* algorithm (CPPC, BM and MC) through
+* perf_event_open. When the counters are
+* not available (no kernel support,
+* perf_event_paranoid, a VM without a
+* PMU) collecting them does nothing.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <fstream>
+#include <mutex>
+#include <stdint.h>
+#include "pool_allocator.hpp"
+
+using namespace std;
+
+enum PerfEvent
+{
+    EVENT_CYCLES,
+    EVENT_INSTRUCTIONS,
+    EVENT_LLC_MISSES,
+    EVENT_BRANCH_MISSES,
+    NUM_PERF_EVENTS
+};
+
+struct PerfStats
+{
+    uint64_t count[NUM_PERF_EVENTS];
+    uint64_t calls;
+};
+
+// the stages are the ones the allocations are attributed to, see AllocStage
+class PerfCounters
+{
+    mutable mutex statsLock;
+    PerfStats frameStats[NUM_ALLOC_STAGES];
+    PerfStats runStats[NUM_ALLOC_STAGES];
+    bool available[NUM_PERF_EVENTS];
+    uint64_t unpaired; // begin and end calls that did not pair up, their counts are not attributed
+    bool enabled;
+
+public:
+    PerfCounters();
+    bool enable();
+    bool isEnabled() const { return enabled; }
+    void begin(AllocStage stage);
+    void end(AllocStage stage); // counted only if it ends the stage this thread began last
+    void beginFrame();
+    void writeLegend(ofstream &file) const;
+    void writeFrameStats(ofstream &file, int frameNo) const;
+    void writeRunStats(ofstream &file) const;
+};
+
+PerfCounters &getPerfCounters();
+
+#define PERF_STATS_FILE "perf-counters.txt"
+
+#endif
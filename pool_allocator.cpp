@@ -0,0 +1,281 @@
+/*
+****************************************
+* This file contains the definitions of
+* the pooling allocator used by the
+* interpolation engine.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <opencv2/core/ocl.hpp>
+#include <atomic>
+#include <string.h>
+#include "pool_allocator.hpp"
+
+using namespace cv;
+using namespace std;
+
+#define MIN_POOL_BLOCK 64                 // smallest size class in bytes
+#define MAX_POOL_BLOCK (64 * 1024 * 1024) // bigger buffers go straight to the system
+#define POOL_TRIM_FRAMES 16               // frames between two trims of the free lists
+
+static const char *stageNames[NUM_ALLOC_STAGES] = {"Other", "CPPC", "BM", "MC"};
+// not thread local : the stages split their work over parallel_for_, whose workers never set a stage
+static atomic<int> currentStage(STAGE_OTHER);
+
+static int sizeClass(size_t size, size_t &classSize)
+{
+    // size classes are 64, 96, 128, 192, 256, 384, ... bytes
+    size_t base = MIN_POOL_BLOCK;
+    int c = 0;
+    if (size > MAX_POOL_BLOCK)
+    {
+        classSize = size;
+        return -1;
+    }
+    while (1)
+    {
+        if (size <= base)
+        {
+            classSize = base;
+            return c;
+        }
+        if (size <= base + base / 2)
+        {
+            classSize = base + base / 2;
+            return c + 1;
+        }
+        base <<= 1;
+        c += 2;
+    }
+}
+
+static size_t classBytes(int c)
+{
+    // the size of class c, the inverse of sizeClass
+    size_t base = (size_t)MIN_POOL_BLOCK << (c / 2);
+    return c % 2 ? base + base / 2 : base;
+}
+
+static void addAllocation(AllocStats &stats, size_t size, bool fromSystem, size_t liveBytes)
+{
+    stats.allocations++;
+    stats.bytes += size;
+    if (fromSystem)
+        stats.systemAllocations++;
+    if (liveBytes > stats.peakLiveBytes)
+        stats.peakLiveBytes = liveBytes;
+}
+
+PoolAllocator::PoolAllocator() : liveBytes(0), pooledBytes(0), trimmedBytes(0), framesSinceTrim(0), installed(false)
+{
+    memset(frameStats, 0, sizeof(frameStats));
+    memset(&runStats, 0, sizeof(runStats));
+}
+
+PoolAllocator::~PoolAllocator()
+{
+    for (auto &freeList : freeLists)
+        for (auto data : freeList)
+            fastFree(data);
+}
+
+uchar *PoolAllocator::acquire(size_t size) const
+{
+    size_t classSize;
+    int c = sizeClass(size, classSize);
+    uchar *data = NULL;
+    bool fromSystem = true;
+
+    lock_guard<mutex> guard(poolLock);
+    if (c >= (int)freeLists.size())
+    {
+        freeLists.resize(c + 1);
+        inUse.resize(c + 1, 0);
+        peakInUse.resize(c + 1, 0);
+    }
+    if (c >= 0)
+        peakInUse[c] = max(peakInUse[c], ++inUse[c]);
+    if (c >= 0 && !freeLists[c].empty())
+    {
+        data = freeLists[c].back();
+        freeLists[c].pop_back();
+        pooledBytes -= classSize;
+        fromSystem = false;
+    }
+    else
+    {
+        data = (uchar *)fastMalloc(classSize);
+    }
+    liveBytes += classSize;
+    addAllocation(frameStats[currentStage.load()], size, fromSystem, liveBytes);
+    addAllocation(runStats, size, fromSystem, liveBytes);
+    return data;
+}
+
+void PoolAllocator::release(uchar *data, size_t size) const
+{
+    size_t classSize;
+    int c = sizeClass(size, classSize);
+
+    lock_guard<mutex> guard(poolLock);
+    liveBytes -= classSize;
+    if (c < 0)
+    {
+        fastFree(data);
+        return;
+    }
+    inUse[c]--;
+    freeLists[c].push_back(data);
+    pooledBytes += classSize;
+}
+
+UMatData *PoolAllocator::allocate(int dims, const int *sizes, int type, void *data0, size_t *step, AccessFlag /*flags*/, UMatUsageFlags /*usageFlags*/) const
+{
+    // same layout as the default OpenCV allocator, only the buffer comes from the pool
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--)
+    {
+        if (step)
+        {
+            if (data0 && step[i] != CV_AUTOSTEP)
+            {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            }
+            else
+                step[i] = total;
+        }
+        total *= sizes[i];
+    }
+    uchar *data = data0 ? (uchar *)data0 : acquire(total);
+    UMatData *u = new UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if (data0)
+        u->flags |= UMatData::USER_ALLOCATED;
+
+    return u;
+}
+
+bool PoolAllocator::allocate(UMatData *u, AccessFlag /*accessFlags*/, UMatUsageFlags /*usageFlags*/) const
+{
+    if (!u)
+        return false;
+    return true;
+}
+
+void PoolAllocator::deallocate(UMatData *u) const
+{
+    if (!u)
+        return;
+
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (!(u->flags & UMatData::USER_ALLOCATED))
+    {
+        release(u->origdata, u->size);
+        u->origdata = 0;
+    }
+    delete u;
+}
+
+void PoolAllocator::install()
+{
+    // UMats only use the default Mat allocator when OpenCL is off,
+    // otherwise their buffers would live on the device
+    ocl::setUseOpenCL(false);
+    Mat::setDefaultAllocator(this);
+    installed = true;
+}
+
+void PoolAllocator::setStage(AllocStage stage) const
+{
+    currentStage = stage;
+}
+
+void PoolAllocator::trim()
+{
+    /* a size class keeps the free buffers the frames since the last trim needed on top of the ones in use now,
+       the rest go back to the system so that a burst (a scene cut, a larger input) is not held for the whole run */
+    for (size_t c = 0; c < freeLists.size(); c++)
+    {
+        size_t keep = peakInUse[c] - inUse[c];
+        size_t classSize = classBytes((int)c);
+        while (freeLists[c].size() > keep)
+        {
+            fastFree(freeLists[c].back());
+            freeLists[c].pop_back();
+            pooledBytes -= classSize;
+            trimmedBytes += classSize;
+        }
+        peakInUse[c] = inUse[c];
+    }
+}
+
+void PoolAllocator::beginFrame()
+{
+    lock_guard<mutex> guard(poolLock);
+    if (++framesSinceTrim >= POOL_TRIM_FRAMES)
+    {
+        trim();
+        framesSinceTrim = 0;
+    }
+    memset(frameStats, 0, sizeof(frameStats));
+    for (int s = 0; s < NUM_ALLOC_STAGES; s++)
+        frameStats[s].peakLiveBytes = liveBytes;
+}
+
+AllocStats PoolAllocator::frameTotal() const
+{
+    AllocStats total;
+    memset(&total, 0, sizeof(total));
+
+    lock_guard<mutex> guard(poolLock);
+    for (int s = 0; s < NUM_ALLOC_STAGES; s++)
+    {
+        total.allocations += frameStats[s].allocations;
+        total.systemAllocations += frameStats[s].systemAllocations;
+        total.bytes += frameStats[s].bytes;
+        total.peakLiveBytes = max(total.peakLiveBytes, frameStats[s].peakLiveBytes);
+    }
+    return total;
+}
+
+void PoolAllocator::writeFrameStats(ofstream &file, int frameNo) const
+{
+    if (!file)
+    {
+        cout << "Could not open the file\n";
+        exit(-1);
+    }
+    AllocStats total = frameTotal();
+
+    lock_guard<mutex> guard(poolLock);
+    file << "Frame " << frameNo << " : " << total.allocations << " allocations (" << total.systemAllocations << " from system), "
+         << total.bytes << " bytes, peak live " << total.peakLiveBytes << " bytes";
+    for (int s = 0; s < NUM_ALLOC_STAGES; s++)
+        file << " | " << stageNames[s] << " " << frameStats[s].allocations << "/" << frameStats[s].systemAllocations
+             << "/" << frameStats[s].bytes << "/" << frameStats[s].peakLiveBytes;
+    file << "\n";
+}
+
+void PoolAllocator::writeRunStats(ofstream &file) const
+{
+    if (!file)
+    {
+        cout << "Could not open the file\n";
+        exit(-1);
+    }
+    lock_guard<mutex> guard(poolLock);
+    file << "Run : " << runStats.allocations << " allocations (" << runStats.systemAllocations << " from system), "
+         << runStats.bytes << " bytes, peak live " << runStats.peakLiveBytes << " bytes, "
+         << pooledBytes << " bytes held by the pool, " << trimmedBytes << " bytes returned to the system by the trims\n";
+}
+
+PoolAllocator &getPoolAllocator()
+{
+    // never destroyed, UMats released during exit may still return their buffers to it
+    static PoolAllocator *pool = new PoolAllocator();
+    return *pool;
+}
@@ -0,0 +1,86 @@
+/*
+****************************************
+* This file contains the declaration
+* of the pooling allocator used by the
+* interpolation engine. Buffers are
+* recycled through size classes so that
+* the short lived UMats created for every
+* block do not reach the system heap once
+* the pool is warm. Every POOL_TRIM_FRAMES
+* frames the free lists are trimmed to
+* the most buffers the frames of that
+* window needed. It also keeps the
+* allocation counters of every frame and
+* every stage of the algorithm.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef POOL_ALLOCATOR_HPP
+#define POOL_ALLOCATOR_HPP
+
+#include <opencv2/core.hpp>
+#include <iostream>
+#include <fstream>
+#include <mutex>
+
+using namespace cv;
+using namespace std;
+
+// stages of the algorithm that allocations are attributed to
+enum AllocStage
+{
+    STAGE_OTHER,
+    STAGE_CPPC,
+    STAGE_BM,
+    STAGE_MC,
+    NUM_ALLOC_STAGES
+};
+
+struct AllocStats
+{
+    size_t allocations;       // number of buffers requested
+    size_t systemAllocations; // requests that could not be served from the pool
+    size_t bytes;             // bytes requested
+    size_t peakLiveBytes;     // highest number of bytes in use at the same time
+};
+
+class PoolAllocator : public MatAllocator
+{
+    mutable mutex poolLock;
+    mutable vector<vector<uchar *>> freeLists; // one list of free buffers per size class
+    mutable vector<size_t> inUse, peakInUse;    // buffers of every size class in use, now and at most since the last trim
+    mutable AllocStats frameStats[NUM_ALLOC_STAGES];
+    mutable AllocStats runStats;
+    mutable size_t liveBytes, pooledBytes, trimmedBytes;
+    int framesSinceTrim;
+    bool installed;
+
+    void trim();
+
+    uchar *acquire(size_t size) const;
+    void release(uchar *data, size_t size) const;
+
+public:
+    PoolAllocator();
+    ~PoolAllocator();
+
+    UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, AccessFlag flags, UMatUsageFlags usageFlags) const CV_OVERRIDE;
+    bool allocate(UMatData *data, AccessFlag accessflags, UMatUsageFlags usageFlags) const CV_OVERRIDE;
+    void deallocate(UMatData *data) const CV_OVERRIDE;
+
+    void install();
+    bool isInstalled() const { return installed; }
+    // the stage of the thread that runs the engine, the allocations of the parallel_for_ workers it starts count for it as well
+    void setStage(AllocStage stage) const;
+    void beginFrame();
+    AllocStats frameTotal() const;
+    void writeFrameStats(ofstream &file, int frameNo) const;
+    void writeRunStats(ofstream &file) const;
+};
+
+PoolAllocator &getPoolAllocator();
+
+#define ALLOC_STATS_FILE "allocation-stats.txt"
+
+#endif
@@ -0,0 +1,32 @@
+/*
+****************************************
+* This file contains the definitions of
+* the speed presets.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include "presets.hpp"
+
+using namespace cv;
+using namespace std;
+
+static const SpeedPreset presets[] = {
+    {"ultrafast", 3, 4.0f, true, 3},
+    {"fast", 5, 2.0f, true, 2},
+    {"balanced", 0, 1.0f, true, 1},
+    {"quality", 0, 0.0f, false, 1},
+};
+
+bool getSpeedPreset(const String &name, SpeedPreset &preset)
+{
+    for (auto &p : presets)
+    {
+        if (p.name == name)
+        {
+            preset = p;
+            return true;
+        }
+    }
+    return false;
+}
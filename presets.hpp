@@ -0,0 +1,48 @@
+/*
+****************************************
+* This file contains the speed presets
+* of the algorithm. A faster preset
+* evaluates fewer candidates per block
+* and fewer local regions per frame, at
+* the cost of a lower PSNR.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+/*
+* Preset     candidates  early exit  partial SAD  local CPPC
+* ultrafast  3           4.0         yes          every 3rd region
+* fast       5           2.0         yes          every 2nd region
+* balanced   all         1.0         yes          all regions
+* quality    all         off         no           all regions (default, same as before presets existed)
+*
+* The throughput and PSNR of each preset have not been measured yet, the
+* settings follow from the work each one skips.
+* To measure the presets :
+*   cd benchmark && make compare-presets               (PSNR against the true halfway frame and ms per
+*                                                        frame pair on the synthetic clips, in benchmark.txt)
+*   ./main video/penguin_30_part2.mp4 --preset fast   (timings in execution-time.txt)
+*   cd quality && ./quality                            (PSNR / SSIM in image_quality.txt)
+*/
+#ifndef PRESETS_HPP
+#define PRESETS_HPP
+
+#include <opencv2/core.hpp>
+
+using namespace cv;
+using namespace std;
+
+struct SpeedPreset
+{
+    String name;
+    int maxCandidates;   // candidates scored per block, 0 for all of them
+    float earlyExitSAD;  // mean absolute difference per pixel at which a block stops searching, 0 to disable
+    bool partialSAD;     // stop accumulating a SAD once it exceeds the best SAD of the block
+    int localRegionStep; // phase correlation is run on every n-th local region, the others copy a neighbor
+};
+
+bool getSpeedPreset(const String &name, SpeedPreset &preset);
+
+#define DEFAULT_PRESET "quality"
+
+#endif
@@ -0,0 +1,181 @@
+/*
+****************************************
+* This file contains the definitions of
+* the quadtree merge and split steps of
+* block matching.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <algorithm>
+#include <functional>
+#include "quadtree.hpp"
+#include "bmc.hpp"
+#include "util.hpp"
+
+using namespace cv;
+using namespace std;
+
+int quadtreeLevel(int size)
+{
+    int level = 0;
+    while (size < QUADTREE_MAX_BLOCK && level < QUADTREE_LEVELS - 1)
+    {
+        size *= 2;
+        level++;
+    }
+    return level;
+}
+
+Point2f bestCandidate(const Mat &prevInt, const Mat &currInt, Rect region, const vector<Point2f> &candidates, int &bestSAD, size_t &sadPixels)
+{
+    /* the candidate with the lowest SAD over region, every rounded displacement is scored once
+       and stops being scored once it cannot beat the best one */
+    vector<Point> scored;
+    Point best(0, 0);
+    bestSAD = INT_MAX;
+    for (auto point : candidates)
+    {
+        Point d((int)round(point.x), (int)round(point.y));
+        if (find(scored.begin(), scored.end(), d) != scored.end())
+            continue;
+        scored.push_back(d);
+        int SAD = regionSADInt(prevInt, currInt, region, d, bestSAD);
+        sadPixels += region.area();
+        if (SAD < bestSAD)
+        {
+            bestSAD = SAD;
+            best = d;
+        }
+    }
+    return Point2f((float)best.x, (float)best.y);
+}
+
+void BlockMatchingCorrelation::mergeBlocks(const Mat &prevInt, const Mat &currInt, vector<vector<char>> &merged)
+{
+    /* 2x2 blocks are matched as one node first, when one vector fits the whole node the four
+       blocks take it and are skipped by the block search. The last two block rows overlap and are never merged */
+    vector<Point2f> candidates;
+    merged.assign(NUM_BLOCKS_Y, vector<char>(NUM_BLOCKS_X, 0));
+    for (int i = 0; i + 1 < NUM_BLOCKS_Y - 2; i += 2)
+    {
+        for (int j = 0; j + 1 < NUM_BLOCKS_X; j += 2)
+        {
+            Rect node(j * BLOCK_SIZE, i * BLOCK_SIZE, QUADTREE_MAX_BLOCK, QUADTREE_MAX_BLOCK);
+            candidates.clear();
+            regionCandidates(i, j, candidates);
+            for (int a = 0; a < 2; a++)
+                for (int b = 0; b < 2; b++)
+                    candidates.push_back(medianNeighbor(i + a, j + b, prevBlockMV));
+            // the nodes above are only known when they were merged as well
+            if (i > 0 && merged[i - 1][j])
+                candidates.push_back(currBlockMV[i - 1][j]);
+            if (j > 0 && merged[i][j - 1])
+                candidates.push_back(currBlockMV[i][j - 1]);
+
+            int SAD;
+            Point2f mv = bestCandidate(prevInt, currInt, node, candidates, SAD, sadPixels);
+            if (SAD > QUADTREE_MERGE_SAD * levelScale * node.area())
+                continue;
+            for (int a = 0; a < 2; a++)
+            {
+                for (int b = 0; b < 2; b++)
+                {
+                    currBlockMV[i + a][j + b] = mv;
+                    blockSAD[i + a][j + b] = SAD / 4 + (a == 0 && b == 0 ? SAD % 4 : 0); // the four add up to SAD
+                    merged[i + a][j + b] = 1;
+                }
+            }
+        }
+    }
+}
+
+void BlockMatchingCorrelation::splitBlocks(const Mat &prevInt, const Mat &currInt, const vector<vector<char>> &merged, const vector<vector<char>> &global)
+{
+    /* builds the partition used by motion compensation : merged nodes, blocks of the grid, and
+       blocks split into four while the children match better than their parent.
+       Blocks that follow the global motion model are left to the warp */
+    vector<Point2f> candidates;
+
+    // the node is replaced by its children when their SADs add up to less than its own
+    function<void(int, int, const QTBlock &)> split = [&](int i, int j, const QTBlock &node) {
+        int size = node.rect.width / 2;
+        if (size < QUADTREE_MIN_BLOCK || node.SAD <= QUADTREE_SPLIT_SAD * levelScale * node.rect.area())
+        {
+            partition.push_back(node);
+            quadtreeBlocks[quadtreeLevel(node.rect.width)]++;
+            return;
+        }
+        vector<QTBlock> children;
+        int childrenSAD = 0;
+        for (int a = 0; a < 2; a++)
+        {
+            for (int b = 0; b < 2; b++)
+            {
+                QTBlock child;
+                int SAD;
+                child.rect = Rect(node.rect.x + b * size, node.rect.y + a * size, size, size);
+                candidates.clear();
+                candidates.push_back(node.mv);
+                if (i > 0)
+                    candidates.push_back(currBlockMV[i - 1][j]);
+                if (i + 1 < NUM_BLOCKS_Y)
+                    candidates.push_back(currBlockMV[i + 1][j]);
+                if (j > 0)
+                    candidates.push_back(currBlockMV[i][j - 1]);
+                if (j + 1 < NUM_BLOCKS_X)
+                    candidates.push_back(currBlockMV[i][j + 1]);
+                regionCandidates(i, j, candidates);
+                for (auto &sibling : children)
+                    candidates.push_back(sibling.mv);
+                child.mv = bestCandidate(prevInt, currInt, child.rect, candidates, SAD, sadPixels);
+                child.SAD = SAD;
+                childrenSAD += child.SAD;
+                children.push_back(child);
+            }
+        }
+        if (childrenSAD >= node.SAD)
+        {
+            partition.push_back(node);
+            quadtreeBlocks[quadtreeLevel(node.rect.width)]++;
+            return;
+        }
+        for (auto &child : children)
+            split(i, j, child);
+    };
+
+    // the nodes are listed row by row, the last block row overlaps the one above it and comes last
+    partition.clear();
+    for (int i = 0; i < NUM_BLOCKS_Y; i++)
+    {
+        for (int j = 0; j < NUM_BLOCKS_X; j++)
+        {
+            QTBlock block;
+            if (!global.empty() && global[i][j])
+                continue;
+            if (!merged.empty() && merged[i][j])
+            {
+                // a merged node is listed once, at its top-left block
+                if (i % 2 == 0 && j % 2 == 0)
+                {
+                    block.rect = Rect(j * BLOCK_SIZE, i * BLOCK_SIZE, QUADTREE_MAX_BLOCK, QUADTREE_MAX_BLOCK);
+                    block.mv = currBlockMV[i][j];
+                    block.SAD = blockSAD[i][j] + blockSAD[i][j + 1] + blockSAD[i + 1][j] + blockSAD[i + 1][j + 1];
+                    partition.push_back(block);
+                    quadtreeBlocks[0]++;
+                }
+                continue;
+            }
+            block.rect = Rect(j * BLOCK_SIZE, min(i * BLOCK_SIZE, prevInt.rows - BLOCK_SIZE), BLOCK_SIZE, BLOCK_SIZE);
+            block.mv = currBlockMV[i][j];
+            block.SAD = blockSAD[i][j];
+            size_t first = partition.size();
+            split(i, j, block);
+            // the block keeps its grid vector, its SAD is the one of the nodes that replaced it
+            int SAD = 0;
+            for (size_t k = first; k < partition.size(); k++)
+                SAD += partition[k].SAD;
+            blockSAD[i][j] = SAD;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+/*
+****************************************
+* This file contains the declaration
+* of the quadtree partition used for
+* variable block size motion
+* estimation. 2x2 blocks that move
+* together are matched as one 64x64
+* node, a block that matches badly is
+* split into four until the children
+* stop improving the match or reach
+* QUADTREE_MIN_BLOCK.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef QUADTREE_HPP
+#define QUADTREE_HPP
+
+#include <opencv2/core.hpp>
+#include "constants.hpp"
+
+using namespace cv;
+using namespace std;
+
+struct QTBlock
+{
+    Rect rect;  // in frame coordinates, the nodes of the last block row overlap the row above
+    Point2f mv; // rounded, as the vectors of the fixed grid
+    int SAD;
+};
+
+int quadtreeLevel(int size); // 0 for QUADTREE_MAX_BLOCK, QUADTREE_LEVELS - 1 for QUADTREE_MIN_BLOCK
+Point2f bestCandidate(const Mat &prevInt, const Mat &currInt, Rect region, const vector<Point2f> &candidates, int &bestSAD, size_t &sadPixels);
+
+#endif
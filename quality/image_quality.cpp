@@ -13,10 +13,22 @@
 */
 
 #include "image_quality.hpp"
+#include "../frame_cache.hpp"
 
-void readFrames(String videoFile, vector<UMat> &frames)
+void readFrames(String videoFile, vector<UMat> &frames, Size size)
 {
-    /* reads the images from the video folder */
+    /* reads the images from the video folder, resized to size unless it is empty */
+    // the original frames point into the mapping of the cache until the tool exits
+    static FrameCacheHandle inputCache;
+    vector<Mat> cached;
+    // only the input is cached, the interpolated video changes with every run. It is cached at the
+    // geometry of the interpolated video, the one main caches and interpolates it at
+    if (videoFile == INPUT_VIDEO && cachedFrames(videoFile, size, cached, inputCache))
+    {
+        for (auto &fr : cached)
+            frames.push_back(fr.getUMat(ACCESS_READ));
+        return;
+    }
     VideoCapture cap(videoFile);
     // check if video opened successfully
     if (!cap.isOpened())
@@ -32,6 +44,8 @@ void readFrames(String videoFile, vector<UMat> &frames)
         // If the frame is empty, break immediately
         if (fr.empty())
             break;
+        if (!size.empty() && fr.size() != size)
+            resize(fr, fr, size);
 
         frames.push_back(fr);
         // Press  ESC on keyboard to  exit
@@ -139,10 +153,10 @@ void calcQuality()
     size_t count;
     double psnr;
     Scalar mssim;
-    // reading original frames
-    readFrames(INPUT_VIDEO, originalFrames);
     // reading interpolated frames
     readFrames(INTERPOLATED_VIDEO, interpolatedFrames);
+    // reading original frames, at the size of the interpolated ones
+    readFrames(INPUT_VIDEO, originalFrames, interpolatedFrames.empty() ? Size() : interpolatedFrames[0].size());
     // performing analysis and storing the result
     if (interpolatedFrames.size() != originalFrames.size())
     {
@@ -165,6 +179,9 @@ void calcQuality()
 }
 
 int main(int argc, char **argv){
+	// --frame-cache maps the input from the cache written by ./main --frame-cache
+	if (argc > 1 && String(argv[1]) == "--frame-cache")
+		enableFrameCache("../" FRAME_CACHE_DIR);
 	cout<<"Calculating Frame Quality ...";
 	calcQuality();
 	return 0;
@@ -172,5 +189,5 @@ int main(int argc, char **argv){
 
 /*
 To compile from terminal, execute the following commad :
-g++ *.cpp -o quality `pkg-config --cflags --libs opencv4`
+g++ *.cpp ../frame_cache.cpp -o quality `pkg-config --cflags --libs opencv4`
 */
@@ -25,7 +25,7 @@
 using namespace cv;
 using namespace std;
 
-void readFrames(String fileName, vector<UMat> &frames);
+void readFrames(String fileName, vector<UMat> &frames, Size size = Size());
 double getPSNR(const Mat &I1, const Mat &I2);
 Scalar getMSSIM(const Mat &i1, const Mat &i2);
 void writeValuesToFile(ofstream &resFile, int frameNo, double psnr, Scalar mssim);
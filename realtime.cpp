@@ -0,0 +1,189 @@
+/*
+****************************************
+* This file contains the definitions of
+* the realtime mode.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <algorithm>
+#include "realtime.hpp"
+#include "util.hpp"
+#include "metrics.hpp"
+
+using namespace cv;
+using namespace std;
+
+static const char *levelNames[NUM_LEVELS] = {"full", "global CPPC only", "reused vectors", "linear blend"};
+
+RealtimeInterpolator::RealtimeInterpolator(BlockMatchingCorrelation &engine, double budgetMs)
+    : engine(engine), budget(budgetMs), localCost(0), estimationCost(0), deadlineMisses(0), pairs(0), maxLatency(0)
+{
+    for (int l = 0; l < NUM_LEVELS; l++)
+    {
+        expectedCost[l] = 0;
+        levelCount[l] = 0;
+    }
+    for (int b = 0; b < LATENCY_BINS; b++)
+        latencyBins[b] = 0;
+}
+
+DegradeLevel RealtimeInterpolator::chooseLevel(double remaining) const
+{
+    // the first pair has no vectors to reuse and no measured costs, it runs in full
+    if (pairs == 0)
+        return LEVEL_FULL;
+    for (int l = LEVEL_FULL; l < LEVEL_BLEND; l++)
+    {
+        if (expectedCost[l] * DEADLINE_MARGIN <= remaining)
+            return (DegradeLevel)l;
+    }
+    return LEVEL_BLEND;
+}
+
+void RealtimeInterpolator::updateCosts(DegradeLevel level, double cost)
+{
+    const StageTimes &times = engine.getStageTimes();
+    int rateFactor = engine.getRateFactor();
+
+    // the levels share their stages, the cost of a level that was not used is rebuilt from
+    // the stages measured on this pair and the last measured time of the stages it adds.
+    // A level that did not fit the budget is not tried again just to find out that it still does not fit
+    if (level == LEVEL_FULL)
+    {
+        // a full pair also tells what the cheaper levels would have cost
+        double compensation = times.MC * (rateFactor - 1);
+        double other = max(0.0, cost - times.globalCPPC - times.localCPPC - times.BM - compensation);
+        localCost = times.localCPPC;
+        estimationCost = times.globalCPPC + times.BM;
+        expectedCost[LEVEL_GLOBAL_CPPC] = estimationCost + compensation + other;
+        expectedCost[LEVEL_REUSE_MV] = compensation + other;
+    }
+    else if (level == LEVEL_GLOBAL_CPPC)
+    {
+        estimationCost = times.globalCPPC + times.BM;
+        expectedCost[LEVEL_FULL] = cost + localCost;
+        expectedCost[LEVEL_REUSE_MV] = max(0.0, cost - estimationCost);
+    }
+    else if (level == LEVEL_REUSE_MV)
+    {
+        expectedCost[LEVEL_GLOBAL_CPPC] = cost + estimationCost;
+        expectedCost[LEVEL_FULL] = cost + estimationCost + localCost;
+    }
+    expectedCost[level] = levelCount[level] == 1 ? cost : 0.8 * expectedCost[level] + 0.2 * cost;
+}
+
+void RealtimeInterpolator::addLatency(double ms)
+{
+    latencyBins[min(LATENCY_BINS - 1, (int)(ms / LATENCY_BIN_MS))]++;
+    maxLatency = max(maxLatency, ms);
+}
+
+double RealtimeInterpolator::latencyPercentile(double p) const
+{
+    // the upper edge of the bin that holds the percentile, the maximum for the last bin
+    int target = (int)(p * pairs), count = 0;
+    for (int b = 0; b < LATENCY_BINS - 1; b++)
+    {
+        count += latencyBins[b];
+        if (count > target)
+            return min(maxLatency, (b + 1) * LATENCY_BIN_MS);
+    }
+    return maxLatency;
+}
+
+void RealtimeInterpolator::printStats() const
+{
+    // latency of a pair : from the arrival of its second frame to the last output frame written
+    cout << pairs << " frame pairs, " << deadlineMisses << " deadline misses (budget " << budget << " ms) :";
+    for (int l = 0; l < NUM_LEVELS; l++)
+        cout << " " << levelNames[l] << " " << levelCount[l];
+    cout << ", latency p50 " << latencyPercentile(0.5) << " ms, p95 " << latencyPercentile(0.95) << " ms, max " << maxLatency << " ms" << endl;
+}
+
+bool RealtimeInterpolator::run(const String &input, const String &output)
+{
+    VideoCapture cap(input);
+    VideoWriter writer;
+    UMat prev, curr;
+    int rateFactor = engine.getRateFactor();
+    Size frameSize(FRAME_WIDTH, FRAME_HEIGHT);
+
+    if (!cap.isOpened())
+    {
+        cout << "Error opening video stream or file " << input << endl;
+        return false;
+    }
+    double fps = cap.get(CAP_PROP_FPS);
+    if (fps <= 0)
+        fps = 30;
+    if (budget <= 0)
+        budget = 1000.0 / fps; // a pair has to be done before the next input frame arrives
+    writer.open(output, VideoWriter::fourcc('X', 'V', 'I', 'D'), rateFactor * fps, frameSize);
+    if (!writer.isOpened())
+    {
+        cout << "Could not create the output video " << output << endl;
+        return false;
+    }
+    engine.setVerbose(false);
+    getMetrics().beginRun(input, max(0, (int)cap.get(CAP_PROP_FRAME_COUNT) - 1)); // 0 for a pipe
+
+    cap >> prev;
+    if (prev.empty())
+        return false;
+    if (prev.size() != frameSize)
+        resize(prev, prev, frameSize);
+
+    while (1)
+    {
+        // the only lookahead is the next input frame, the clock starts when it has arrived
+        cap >> curr;
+        if (curr.empty())
+            break;
+        auto arrival = chrono::steady_clock::now();
+        if (curr.size() != frameSize)
+            resize(curr, curr, frameSize);
+
+        DegradeLevel level = chooseLevel(budget - msSince(arrival));
+        levelCount[level]++;
+        if (level == LEVEL_FULL || level == LEVEL_GLOBAL_CPPC)
+        {
+            engine.setLocalCPPC(level == LEVEL_FULL);
+            engine.motionEstimation(prev, curr);
+        }
+
+        writer << prev;
+        for (int k = 1; k < rateFactor; k++)
+        {
+            UMat interpolatedFrame;
+            double t = (double)k / rateFactor;
+            if (level == LEVEL_BLEND)
+                addWeighted(prev, 1.0 - t, curr, t, 0.0, interpolatedFrame);
+            else
+                engine.motionCompensation(prev, curr, interpolatedFrame, t);
+            writer << interpolatedFrame;
+        }
+
+        double cost = msSince(arrival);
+        // the stages that were skipped at this level report no time
+        StageTimes times = engine.getStageTimes();
+        if (level == LEVEL_REUSE_MV || level == LEVEL_BLEND)
+            times.globalCPPC = times.localCPPC = times.BM = 0;
+        if (level == LEVEL_BLEND)
+            times.MC = 0;
+        getMetrics().pairDone(pairs, times, cost);
+        addLatency(cost);
+        updateCosts(level, cost);
+        if (cost > budget)
+            deadlineMisses++;
+        pairs++;
+        if (pairs % (int)ceil(fps) == 0)
+            printStats();
+        prev = curr;
+    }
+    writer << prev;
+    writer.release();
+    engine.setLocalCPPC(true);
+    printStats();
+    return true;
+}
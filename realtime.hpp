@@ -0,0 +1,57 @@
+/*
+****************************************
+* This file contains the declaration
+* of the realtime mode. Frames are read
+* from a pipe or FIFO and every output
+* frame is written with one frame of
+* lookahead. When a frame pair would
+* miss its time budget the algorithm
+* is degraded instead of dropping the
+* output frame.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef REALTIME_HPP
+#define REALTIME_HPP
+
+#include <opencv2/core.hpp>
+#include "bmc.hpp"
+
+using namespace cv;
+using namespace std;
+
+// from the best to the cheapest way of building the interpolated frames
+enum DegradeLevel
+{
+    LEVEL_FULL,        // CPPC, block matching and motion compensation
+    LEVEL_GLOBAL_CPPC, // the local regions keep their vectors of the last pair
+    LEVEL_REUSE_MV,    // no motion estimation, the block vectors of the last pair are reused
+    LEVEL_BLEND,       // linear blend of the two frames
+    NUM_LEVELS
+};
+
+class RealtimeInterpolator
+{
+    BlockMatchingCorrelation &engine;
+    double budget;                 // milliseconds available for one frame pair, 0 for the input frame interval
+    double expectedCost[NUM_LEVELS]; // moving average of the time each level takes
+    double localCost;                // last measured time of the local CPPC
+    double estimationCost;           // last measured time of the global CPPC and block matching
+    int levelCount[NUM_LEVELS];
+    int deadlineMisses, pairs;
+    int latencyBins[LATENCY_BINS]; // pairs per latency, the memory does not grow with the length of the stream
+    double maxLatency;
+
+    DegradeLevel chooseLevel(double remaining) const;
+    void updateCosts(DegradeLevel level, double cost);
+    void addLatency(double ms);
+    double latencyPercentile(double p) const;
+    void printStats() const;
+
+public:
+    RealtimeInterpolator(BlockMatchingCorrelation &engine, double budgetMs = 0);
+    bool run(const String &input, const String &output);
+};
+
+#endif
@@ -0,0 +1,224 @@
+/*
+****************************************
+* This file contains the definitions of
+* the segment mode.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <algorithm>
+#include <cfloat>
+#include <memory>
+#include "segments.hpp"
+#include "checkpoint.hpp"
+#include "tiling.hpp"
+#include "util.hpp"
+#include "metrics.hpp"
+
+using namespace cv;
+using namespace std;
+
+// the engine of a chunk, inputs larger than the engine's frame size keep their resolution and are split into tiles
+struct ChunkEngine
+{
+    BlockMatchingCorrelation engine;
+    unique_ptr<TiledInterpolator> tiled;
+
+    ChunkEngine(const BlockMatchingCorrelation &settings, bool tiling) : engine("")
+    {
+        engine.copySettings(settings);
+        engine.setVerbose(false);
+        if (tiling)
+            tiled.reset(new TiledInterpolator(settings));
+    }
+    void motionEstimation(const UMat &prev, const UMat &curr)
+    {
+        if (tiled)
+            tiled->motionEstimation(prev, curr);
+        else
+            engine.motionEstimation(prev, curr);
+    }
+    void motionCompensation(const UMat &prev, const UMat &curr, UMat &interpolatedFrame, double t)
+    {
+        if (tiled)
+            tiled->motionCompensation(prev, curr, interpolatedFrame, t);
+        else
+            engine.motionCompensation(prev, curr, interpolatedFrame, t);
+    }
+    StageTimes getStageTimes() const { return tiled ? StageTimes() : engine.getStageTimes(); } // the stages run per tile
+};
+
+bool SegmentRunner::runSegment(const String &inputVideo, int chunk, int first, int last, vector<UMat> &seamFrames, UMat &seekedFrame) const
+{
+    /* interpolates the pairs first to last - 1 into the segment of the chunk, or into the image sequence at the
+       numbers its frames have in the whole output. The pairs before first only warm up the MV field, the output
+       frames of the first SEAM_CHECK_PAIRS pairs are kept in seamFrames for the seam check */
+    FrameStream stream;
+    ChunkEngine engine(settings, tiling);
+    VideoWriter segment;
+    bool images = isImageSequence(inputVideo);
+    int rateFactor = settings.getRateFactor();
+    int warmFirst = max(0, first - warmup);
+    int outputFrames = first * rateFactor; // number of the next output image
+    UMat prev, interpolatedFrame;
+
+    if (!stream.open(inputVideo, warmFirst, last == INT_MAX ? -1 : last, tiling) || !stream.read(prev))
+        return false;
+    seekedFrame = prev.clone(); // the seam check compares it with the frame decoded serially, after the stream is closed
+
+    auto writeFrame = [&](const UMat &frame, bool seam) {
+        if (seam)
+            seamFrames.push_back(frame.clone()); // interpolatedFrame is overwritten by the next compensation
+        if (images)
+        {
+            // the frames keep their bit depth
+            if (imwrite(format(INTERPOLATED_IMAGES, outputFrames++), frame))
+                return true;
+            cout << "Could not write " << format(INTERPOLATED_IMAGES, outputFrames - 1) << endl;
+            return false;
+        }
+        if (!segment.isOpened() && !openSegment(segment, chunk, fps, frame.size(), SEGMENT_CHUNK_PREFIX))
+            return false;
+        segment << frame;
+        return true;
+    };
+
+    for (int i = warmFirst; i < last; i++)
+    {
+        UMat curr; // a new buffer, prev still references the last one
+        if (!stream.read(curr))
+            break;
+        auto start = chrono::steady_clock::now();
+        engine.motionEstimation(prev, curr);
+        if (i >= first)
+        {
+            bool seam = checkSeams && i < first + SEAM_CHECK_PAIRS;
+            if (!writeFrame(prev, seam))
+                return false;
+            for (int k = 1; k < rateFactor; k++)
+            {
+                engine.motionCompensation(prev, curr, interpolatedFrame, (double)k / rateFactor);
+                if (!writeFrame(interpolatedFrame, seam))
+                    return false;
+            }
+            // the chunks report to the same metrics, the warm-up pairs are not counted
+            getMetrics().pairDone(i, engine.getStageTimes(), msSince(start));
+        }
+        prev = curr;
+    }
+    if (last == INT_MAX && !writeFrame(prev, false))
+        return false; // the last frame of the video
+    // a chunk that reached the end of the video before its first pair has no segment
+    return images || segment.isOpened();
+}
+
+void SegmentRunner::compareWithSerial(const String &inputVideo, const vector<int> &starts, const vector<vector<UMat>> &seamFrames, const vector<UMat> &seekedFrames) const
+{
+    /* runs the video serially up to the last boundary and reports the PSNR of the chunked frames after every
+       boundary, the first frame every chunk decoded after its seek must be the serial frame of the same number */
+    FrameStream stream;
+    ChunkEngine engine(settings, tiling);
+    int rateFactor = settings.getRateFactor();
+    UMat prev;
+
+    if (!stream.open(inputVideo, 0, -1, tiling) || !stream.read(prev))
+        return;
+
+    cout << "Seam check against a serial run (PSNR of the interpolated frames, dB) :" << endl;
+    double sum = 0, worst = DBL_MAX;
+    int count = 0, badSeeks = 0;
+    for (int i = 0; i < starts.back() + SEAM_CHECK_PAIRS; i++)
+    {
+        UMat curr;
+        for (int c = 1; c < (int)starts.size(); c++)
+        {
+            if (i != max(0, starts[c] - warmup))
+                continue;
+            bool same = norm(prev, seekedFrames[c], NORM_INF) == 0;
+            cout << "  chunk " << c << " seeked to frame " << i << (same ? " : same frame as the serial decode" : " : DIFFERENT from the serial decode") << endl;
+            badSeeks += !same;
+        }
+        if (!stream.read(curr))
+            break;
+        engine.motionEstimation(prev, curr);
+        int chunk = (int)(upper_bound(starts.begin(), starts.end(), i) - starts.begin()) - 1;
+        for (int k = 1; k < rateFactor && chunk > 0 && i < starts[chunk] + SEAM_CHECK_PAIRS; k++)
+        {
+            UMat interpolatedFrame;
+            size_t index = (size_t)(i - starts[chunk]) * rateFactor + k;
+            if (index >= seamFrames[chunk].size())
+                break;
+            engine.motionCompensation(prev, curr, interpolatedFrame, (double)k / rateFactor);
+            double psnr = PSNR(interpolatedFrame, seamFrames[chunk][index]);
+            cout << "  chunk " << chunk << ", pair " << i << ", t = " << (double)k / rateFactor << " : " << psnr << endl;
+            sum += psnr;
+            worst = min(worst, psnr);
+            count++;
+        }
+        prev = curr;
+    }
+    if (count > 0)
+        cout << "Seam check : mean " << sum / count << " dB, worst " << worst << " dB over " << count << " frames "
+             << "(the random neighbor candidate keeps two runs from matching exactly)" << endl;
+    if (badSeeks > 0)
+        cout << "Seam check : " << badSeeks << " chunks did not start on the frame they seeked to" << endl;
+}
+
+bool SegmentRunner::run(const String &inputVideo)
+{
+    int numPairs = getFrameCount(inputVideo) - 1;
+    if (numPairs < 1)
+    {
+        cout << "The video needs at least two frames" << endl;
+        return false;
+    }
+    fps = settings.getRateFactor() * getInputFPS(inputVideo);
+    tiling = needsTiling(getInputSize(inputVideo));
+    bool images = isImageSequence(inputVideo);
+
+    // chunks of (almost) the same number of pairs, the frame count of some containers is only an
+    // estimate so the last chunk reads until the end of the video
+    int chunks = min(numChunks, numPairs);
+    vector<int> starts;
+    for (int c = 0; c < chunks; c++)
+        starts.push_back((int)((long)c * numPairs / chunks));
+    vector<vector<UMat>> seamFrames(chunks);
+    vector<UMat> seekedFrames(chunks);
+    vector<char> ok(chunks, 0);
+
+    cout << "Interpolating " << numPairs << " frame pairs in " << chunks << " chunks with " << warmup << " warm-up pairs" << endl;
+    auto start = chrono::steady_clock::now();
+    getMetrics().beginRun(inputVideo, numPairs);
+    parallel_for_(Range(0, chunks), [&](const Range &range) {
+        for (int c = range.start; c < range.end; c++)
+            ok[c] = runSegment(inputVideo, c, starts[c], c + 1 < chunks ? starts[c + 1] : INT_MAX, seamFrames[c], seekedFrames[c]);
+    });
+    cout << "Chunks done in " << msSince(start) << " ms" << endl;
+    for (int c = 0; c < chunks; c++)
+    {
+        if (!ok[c])
+        {
+            cout << "Chunk " << c << " could not read the video or write its output" << endl;
+            if (!images)
+                removeSegments(chunks, SEGMENT_CHUNK_PREFIX);
+            return false;
+        }
+    }
+
+    if (checkSeams)
+        compareWithSerial(inputVideo, starts, seamFrames, seekedFrames);
+
+    if (images)
+    {
+        // the chunks wrote their images at their place in the sequence
+        cout << "...completed the new image sequence\nRelative Path of output images :" << INTERPOLATED_IMAGES << endl;
+        return true;
+    }
+    cout << "Frame interpolation complete, creating new video..." << endl;
+    bool stitched = stitchSegments(chunks, INTERPOLATED_VIDEO, fps, SEGMENT_CHUNK_PREFIX);
+    removeSegments(chunks, SEGMENT_CHUNK_PREFIX);
+    if (!stitched)
+        return false;
+    cout << "...completed the new video\nRelative Path of output video :" << INTERPOLATED_VIDEO << endl;
+    return true;
+}
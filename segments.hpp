@@ -0,0 +1,47 @@
+/*
+****************************************
+* This file contains the declaration
+* of the segment mode. The only state
+* carried from one frame pair to the
+* next is the previous MV field, used
+* for the median candidate, so a long
+* video is split into chunks that run
+* concurrently. Every chunk first
+* estimates a few warm-up pairs before
+* its start and writes its output to a
+* segment file as it goes, the segments
+* are stitched in order.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef SEGMENTS_HPP
+#define SEGMENTS_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include "bmc.hpp"
+
+using namespace cv;
+using namespace std;
+
+class SegmentRunner
+{
+    const BlockMatchingCorrelation &settings;
+    int numChunks;
+    int warmup;      // pairs estimated before the first pair of a chunk
+    bool checkSeams; // compare the pairs after every chunk boundary with a serial run
+    bool tiling;     // the input is larger than the engine's frame size and is split into tiles
+    double fps;      // of the output
+
+    bool runSegment(const String &inputVideo, int chunk, int first, int last, vector<UMat> &seamFrames, UMat &seekedFrame) const;
+    void compareWithSerial(const String &inputVideo, const vector<int> &starts, const vector<vector<UMat>> &seamFrames, const vector<UMat> &seekedFrames) const;
+
+public:
+    SegmentRunner(const BlockMatchingCorrelation &settings, int numChunks, int warmup = SEGMENT_WARMUP)
+        : settings(settings), numChunks(numChunks), warmup(warmup), checkSeams(false), tiling(false), fps(0) {}
+    void setSeamCheck(bool enable) { checkSeams = enable; }
+    bool run(const String &inputVideo);
+};
+
+#endif
@@ -0,0 +1,498 @@
+/*
+****************************************
+* This file contains the definitions of
+* the shard mode coordinator and worker.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include "shard.hpp"
+#include "tiling.hpp"
+#include "util.hpp"
+#include "metrics.hpp"
+
+using namespace cv;
+using namespace std;
+
+#define MAX_MESSAGE_SIZE (1u << 30)
+
+static bool writeAll(int fd, const void *data, size_t length)
+{
+    const char *p = (const char *)data;
+    while (length > 0)
+    {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t length)
+{
+    char *p = (char *)data;
+    while (length > 0)
+    {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool sendMessage(int fd, uint32_t type, const void *payload, uint32_t length)
+{
+    uint32_t header[2] = {type, length};
+    return writeAll(fd, header, sizeof(header)) && (length == 0 || writeAll(fd, payload, length));
+}
+
+bool receiveMessage(int fd, uint32_t &type, vector<char> &payload)
+{
+    uint32_t header[2];
+    if (!readAll(fd, header, sizeof(header)) || header[1] > MAX_MESSAGE_SIZE)
+        return false;
+    type = header[0];
+    payload.resize(header[1]);
+    return header[1] == 0 || readAll(fd, payload.data(), header[1]);
+}
+
+bool socketAddress(const String &socketPath, sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path))
+        return false;
+    strcpy(addr.sun_path, socketPath.c_str());
+    return true;
+}
+
+bool ShardCoordinator::spawnWorker(const String &inputVideo)
+{
+    // the argument list is built before fork, the child only calls exec
+    vector<String> args = {program, "--worker", socketPath, inputVideo};
+    args.insert(args.end(), engineArgs.begin(), engineArgs.end());
+    vector<char *> argv;
+    for (auto &arg : args)
+        argv.push_back((char *)arg.c_str());
+    argv.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0)
+    {
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    children.push_back(pid);
+    spawned++;
+    return true;
+}
+
+bool ShardCoordinator::assignTask(Connection &conn)
+{
+    int t = pending.front();
+    int32_t task[3] = {tasks[t].first, tasks[t].last, max(0, tasks[t].first - warmup)};
+
+    if (!sendMessage(conn.fd, MSG_TASK, task, sizeof(task)))
+        return false;
+    pending.pop_front();
+    conn.task = t;
+    conn.started = chrono::steady_clock::now();
+    return true;
+}
+
+bool ShardCoordinator::failConnection(size_t index, const char *reason)
+{
+    Connection conn = connections[index];
+    connections.erase(connections.begin() + index);
+    close(conn.fd);
+    if (conn.pid > 0 && find(children.begin(), children.end(), conn.pid) != children.end())
+        kill(conn.pid, SIGKILL); // reaped with the other children
+    cout << "Worker " << conn.pid << " " << reason;
+    if (conn.task < 0)
+    {
+        cout << endl;
+        return true;
+    }
+
+    Task &task = tasks[conn.task];
+    cout << ", pairs " << task.first << " to " << (task.last == INT_MAX ? String("the end") : to_string(task.last - 1));
+    if (++task.retries > SHARD_MAX_RETRIES)
+    {
+        cout << " failed " << task.retries << " times, giving up" << endl;
+        return false;
+    }
+    cout << " are handed out again" << endl;
+    pending.push_front(conn.task);
+    return true;
+}
+
+bool ShardCoordinator::handleMessage(Connection &conn)
+{
+    uint32_t type;
+    vector<char> payload;
+
+    if (!receiveMessage(conn.fd, type, payload))
+        return false;
+    if (type == MSG_READY && payload.size() == sizeof(int32_t) && conn.pid == 0)
+    {
+        int32_t pid;
+        memcpy(&pid, payload.data(), sizeof(pid));
+        conn.pid = pid;
+        return true;
+    }
+    if (type != MSG_RESULT || conn.task < 0 || payload.size() < 4 * sizeof(int32_t))
+        return false;
+
+    int32_t header[4];
+    memcpy(header, payload.data(), sizeof(header));
+    Task &task = tasks[conn.task];
+    int first = header[0], count = header[1], peaks = header[2];
+    bool ended = header[3] != 0;
+    // a task covers all of its pairs unless the worker reached the end of the video
+    if (first != task.first || count < 0 || (count > 0 && (peaks < 1 || (numPeaks != 0 && peaks != numPeaks))) ||
+        (!ended && (task.last == INT_MAX || count != task.last - task.first)) ||
+        (task.last != INT_MAX && count > task.last - task.first) ||
+        payload.size() != sizeof(header) + (size_t)count * mvRecordFloats(max(1, peaks)) * sizeof(float))
+        return false;
+    conn.task = -1;
+    if (task.count >= 0)
+    {
+        // the task was dropped because an earlier task reached the end of the video
+        if (count > 0)
+            cout << "Worker " << conn.pid << " found pairs " << first << " to " << first + count - 1 << " past the end of the video, they are ignored" << endl;
+        return true;
+    }
+    if (ended && task.last != INT_MAX)
+    {
+        // the frame count of the container was too high, the video ends inside this task : the tasks
+        // after it are dropped, unless one of them already found pairs (then this worker failed to decode)
+        for (auto &later : tasks)
+            if (later.first > task.first && later.count > 0)
+                return false;
+        for (size_t t = 0; t < tasks.size(); t++)
+        {
+            if (tasks[t].first <= task.first || tasks[t].count >= 0)
+                continue;
+            tasks[t].count = 0;
+            pending.erase(remove(pending.begin(), pending.end(), (int)t), pending.end());
+        }
+        task.last = INT_MAX;
+        cout << "The video ends after pair " << first + count - 1 << ", the frame count of the container was wrong" << endl;
+    }
+
+    if (count > 0)
+        numPeaks = peaks;
+    task.records.resize((size_t)count * mvRecordFloats(max(1, peaks)));
+    memcpy(task.records.data(), payload.data() + sizeof(header), task.records.size() * sizeof(float));
+    task.count = count;
+    if (count > 0)
+    {
+        cout << "Pairs " << first << " to " << first + count - 1 << " estimated by worker " << conn.pid << endl;
+        getMetrics().pairsDone(first + count - 1, count); // the workers do not serve metrics, their results are counted here
+    }
+    return true;
+}
+
+void ShardCoordinator::shutdown(bool killWorkers)
+{
+    for (auto &conn : connections)
+    {
+        sendMessage(conn.fd, MSG_DONE, NULL, 0);
+        close(conn.fd);
+    }
+    connections.clear();
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+        unlink(socketPath.c_str());
+        listenFd = -1;
+    }
+    // workers exit on MSG_DONE, the ones that never connected fail to connect now
+    for (auto pid : children)
+    {
+        if (killWorkers)
+            kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+    children.clear();
+}
+
+bool ShardCoordinator::mergeResults(const String &vectorFile)
+{
+    MVSidecarWriter writer;
+    MVField field;
+
+    if (!writer.open(vectorFile, numPeaks))
+        return false;
+    for (auto &task : tasks)
+    {
+        for (int r = 0; r < task.count; r++)
+        {
+            unpackMVField(task.records.data() + r * mvRecordFloats(numPeaks), numPeaks, field);
+            writer.write(field);
+        }
+        vector<float>().swap(task.records);
+    }
+    writer.close();
+    return true;
+}
+
+void ShardCoordinator::compareWithSerial(const String &inputVideo, const String &vectorFile) const
+{
+    /* estimates the pairs serially and reports how far the merged vectors are from the serial ones
+       for the first SEAM_CHECK_PAIRS pairs of every task */
+    MVSidecarReader reader;
+    VideoCapture cap(inputVideo);
+    BlockMatchingCorrelation serial("");
+    MVField field;
+    UMat prev;
+
+    serial.copySettings(engine);
+    serial.setVerbose(false);
+    if (!reader.open(vectorFile) || !cap.isOpened() || !readFrame(cap, prev))
+        return;
+
+    cout << "Shard check against a serial run (difference of the block vectors) :" << endl;
+    double sum = 0;
+    size_t blocks = 0, within1 = 0;
+    for (size_t i = 0; i < reader.size(); i++)
+    {
+        UMat curr;
+        if (!readFrame(cap, curr))
+            break;
+        serial.motionEstimation(prev, curr);
+        prev = curr;
+        if (i % SHARD_PAIRS >= SEAM_CHECK_PAIRS || !reader.read(i, field))
+            continue;
+        const vector<vector<Point2f>> &serialMV = serial.getBlockMV();
+        double pairSum = 0;
+        size_t pairWithin1 = 0;
+        for (int r = 0; r < NUM_BLOCKS_Y; r++)
+        {
+            for (int c = 0; c < NUM_BLOCKS_X; c++)
+            {
+                double d = norm(field.blockMV[r][c] - serialMV[r][c]);
+                pairSum += d;
+                pairWithin1 += d <= 1.0;
+            }
+        }
+        cout << "  pair " << i << " (task " << i / SHARD_PAIRS << ") : mean " << pairSum / (NUM_BLOCKS_Y * NUM_BLOCKS_X) << " px, "
+             << 100.0 * pairWithin1 / (NUM_BLOCKS_Y * NUM_BLOCKS_X) << "% of the blocks within 1 px" << endl;
+        sum += pairSum;
+        within1 += pairWithin1;
+        blocks += NUM_BLOCKS_Y * NUM_BLOCKS_X;
+    }
+    if (blocks > 0)
+        cout << "Shard check : mean " << sum / blocks << " px, " << 100.0 * within1 / blocks << "% of the blocks within 1 px "
+             << "(the random neighbor candidate keeps two runs from matching exactly)" << endl;
+}
+
+bool ShardCoordinator::run(const String &inputVideo)
+{
+    VideoCapture cap(inputVideo);
+    sockaddr_un addr;
+
+    if (!cap.isOpened())
+    {
+        cout << "Error opening video stream or file" << endl;
+        return false;
+    }
+    int numPairs = (int)cap.get(CAP_PROP_FRAME_COUNT) - 1;
+    cap.release();
+    if (numPairs < 1)
+    {
+        cout << "The video needs at least two frames" << endl;
+        return false;
+    }
+    if (needsTiling(getInputSize(inputVideo)))
+    {
+        cout << "Shard mode supports inputs up to " << FRAME_WIDTH << "x" << FRAME_HEIGHT << endl;
+        return false;
+    }
+
+    // the frame count of some containers is only an estimate, the last task reads until the end of the video
+    for (int first = 0; first < numPairs; first += SHARD_PAIRS)
+    {
+        pending.push_back((int)tasks.size());
+        tasks.push_back({first, first + SHARD_PAIRS >= numPairs ? INT_MAX : first + SHARD_PAIRS, 0, vector<float>(), -1});
+    }
+
+    signal(SIGPIPE, SIG_IGN); // a worker that died is noticed when reading from it
+    socketPath = format("/tmp/bmc-shard-%d.sock", (int)getpid());
+    unlink(socketPath.c_str());
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || !socketAddress(socketPath, addr) || ::bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, numWorkers) != 0)
+    {
+        cout << "Could not create the coordinator socket " << socketPath << endl;
+        shutdown(true);
+        return false;
+    }
+    // the estimation is reported first, then interpolate() reports the motion compensation as a second run
+    getMetrics().beginRun(inputVideo, numPairs);
+    cout << "Coordinator on " << socketPath << " : " << tasks.size() << " tasks of " << SHARD_PAIRS << " frame pairs for " << numWorkers << " workers" << endl;
+    for (int w = 0; w < min(numWorkers, (int)tasks.size()); w++)
+        spawnWorker(inputVideo);
+
+    size_t done = 0;
+    while (done < tasks.size())
+    {
+        vector<pollfd> fds(1 + connections.size());
+        fds[0] = {listenFd, POLLIN, 0};
+        for (size_t k = 0; k < connections.size(); k++)
+            fds[k + 1] = {connections[k].fd, POLLIN, 0};
+        if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR)
+            break;
+
+        // connections accepted now are appended, the indices of the polled ones do not change
+        for (size_t k = fds.size() - 1; k >= 1; k--)
+        {
+            if (fds[k].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                if (!handleMessage(connections[k - 1]) && !failConnection(k - 1, "failed"))
+                {
+                    shutdown(true);
+                    return false;
+                }
+            }
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd >= 0)
+                connections.push_back({fd, 0, -1, chrono::steady_clock::now()});
+        }
+
+        for (size_t k = connections.size(); k-- > 0;)
+        {
+            Connection &conn = connections[k];
+            bool hung = conn.task >= 0 && chrono::steady_clock::now() - conn.started > chrono::seconds(SHARD_TASK_TIMEOUT);
+            // idle workers that announced themselves get the next task
+            bool lost = !hung && conn.task < 0 && conn.pid != 0 && !pending.empty() && !assignTask(conn);
+            if ((hung || lost) && !failConnection(k, hung ? "timed out" : "stopped responding"))
+            {
+                shutdown(true);
+                return false;
+            }
+        }
+
+        // replace the workers that died, as long as some work has not been handed out
+        pid_t pid;
+        while ((pid = waitpid(-1, NULL, WNOHANG)) > 0)
+            children.erase(remove(children.begin(), children.end(), pid), children.end());
+        while ((int)children.size() < numWorkers && !pending.empty() && spawned < numWorkers * (SHARD_MAX_RETRIES + 1))
+        {
+            if (!spawnWorker(inputVideo))
+                break;
+        }
+        if (children.empty() && connections.empty() && !pending.empty())
+        {
+            cout << "No worker is left to process the remaining frame pairs" << endl;
+            shutdown(true);
+            return false;
+        }
+
+        done = count_if(tasks.begin(), tasks.end(), [](const Task &task) { return task.count >= 0; });
+    }
+    shutdown(done < tasks.size());
+    if (done < tasks.size())
+        return false;
+
+    // motion compensation runs in the coordinator from the merged vector fields
+    if (!mergeResults(SHARD_VECTORS_FILE) || !engine.renderFromVectors(SHARD_VECTORS_FILE))
+        return false;
+    cout << "Merged vector fields written to " << SHARD_VECTORS_FILE << endl;
+    if (checkShards)
+        compareWithSerial(inputVideo, SHARD_VECTORS_FILE);
+    engine.interpolate();
+    return true;
+}
+
+bool runShardWorker(BlockMatchingCorrelation &engine, const String &socketPath, const String &inputVideo)
+{
+    sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || !socketAddress(socketPath, addr) || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        cout << "Could not connect to the coordinator on " << socketPath << endl;
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    VideoCapture cap(inputVideo);
+    if (!cap.isOpened())
+    {
+        cout << "Error opening video stream or file" << endl;
+        close(fd);
+        return false;
+    }
+    engine.setVerbose(false);
+
+    int32_t pid = (int32_t)getpid();
+    uint32_t type;
+    vector<char> payload, result;
+    vector<float> record;
+    MVField field;
+    if (!sendMessage(fd, MSG_READY, &pid, sizeof(pid)))
+    {
+        close(fd);
+        return false;
+    }
+
+    while (receiveMessage(fd, type, payload) && type == MSG_TASK && payload.size() == 3 * sizeof(int32_t))
+    {
+        int32_t task[3];
+        memcpy(task, payload.data(), sizeof(task));
+        int first = task[0], last = task[1], warmFirst = task[2];
+        int32_t header[4] = {first, 0, 0, 0};
+        UMat prev;
+
+        // the pairs before first only build the previous MV field used by the median candidate,
+        // a task past the end of the video (its frame count was wrong) returns no pairs
+        result.assign(sizeof(header), 0);
+        bool ended = !seekFrame(cap, inputVideo, warmFirst) || !readFrame(cap, prev);
+        for (int i = warmFirst; i < last && !ended; i++)
+        {
+            UMat curr;
+            if (!readFrame(cap, curr))
+            {
+                ended = true;
+                break;
+            }
+            engine.motionEstimation(prev, curr);
+            if (i >= first)
+            {
+                engine.getMVField(field);
+                header[2] = (int32_t)field.globalRegionMV[0][0].size();
+                packMVField(field, header[2], record);
+                result.insert(result.end(), (const char *)record.data(), (const char *)(record.data() + record.size()));
+                header[1]++;
+            }
+            prev = curr;
+        }
+        header[3] = ended;
+        memcpy(result.data(), header, sizeof(header));
+        if (!sendMessage(fd, MSG_RESULT, result.data(), (uint32_t)result.size()))
+            break;
+    }
+    close(fd);
+    return true;
+}
@@ -0,0 +1,107 @@
+/*
+****************************************
+* This file contains the declaration
+* of the shard mode. A coordinator
+* process splits the frame pairs of one
+* video into tasks and hands them to
+* worker processes over a Unix domain
+* socket. The workers run motion
+* estimation on their pairs and send
+* the vector fields back, the
+* coordinator merges them into a
+* sidecar and renders the video from
+* it. A task whose worker fails is
+* handed out again.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+/*
+* Every message on the socket is : uint32 type, uint32 payload length in bytes, payload.
+*   worker -> coordinator  MSG_READY   int32 pid                         (once, after connecting)
+*   coordinator -> worker  MSG_TASK    int32 first, last, warm-up first  (pairs first to last - 1)
+*   worker -> coordinator  MSG_RESULT  int32 first, count, numPeaks, end of video, count MV sidecar records
+*   coordinator -> worker  MSG_DONE    no payload, the worker exits
+* A worker asks for its next task by sending its result. The tasks come from the frame count of the
+* container, which may be wrong : a worker that reaches the end of the video returns the pairs it found
+* and sets "end of video", the tasks after it are then dropped. Workers may also be started by hand :
+*   ./main --worker socket-path input [options]
+*/
+#ifndef SHARD_HPP
+#define SHARD_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <stdint.h>
+#include <chrono>
+#include <deque>
+#include "bmc.hpp"
+
+using namespace cv;
+using namespace std;
+
+enum ShardMessage
+{
+    MSG_READY = 1,
+    MSG_TASK,
+    MSG_RESULT,
+    MSG_DONE
+};
+
+bool sendMessage(int fd, uint32_t type, const void *payload, uint32_t length);
+bool receiveMessage(int fd, uint32_t &type, vector<char> &payload);
+bool socketAddress(const String &socketPath, sockaddr_un &addr);
+
+class ShardCoordinator
+{
+    struct Task
+    {
+        int first, last; // frame pairs first to last - 1, last is INT_MAX for the final task
+        int retries;
+        vector<float> records;
+        int count; // records received, -1 until the task is done
+    };
+    struct Connection
+    {
+        int fd;
+        pid_t pid;
+        int task; // -1 when idle
+        chrono::steady_clock::time_point started;
+    };
+
+    BlockMatchingCorrelation &engine;
+    String program;
+    vector<String> engineArgs; // options forwarded to the workers
+    int numWorkers, warmup;
+    String socketPath;
+    int listenFd;
+    int spawned;
+    vector<pid_t> children;
+    vector<Connection> connections;
+    vector<Task> tasks;
+    deque<int> pending;
+    int numPeaks;
+    bool checkShards; // compare the merged vectors with a serial run
+
+    bool spawnWorker(const String &inputVideo);
+    bool assignTask(Connection &conn);
+    bool failConnection(size_t index, const char *reason);
+    bool handleMessage(Connection &conn);
+    void shutdown(bool killWorkers);
+    bool mergeResults(const String &vectorFile);
+    void compareWithSerial(const String &inputVideo, const String &vectorFile) const;
+
+public:
+    ShardCoordinator(BlockMatchingCorrelation &engine, const String &program, const vector<String> &engineArgs, int numWorkers, int warmup = SEGMENT_WARMUP)
+        : engine(engine), program(program), engineArgs(engineArgs), numWorkers(numWorkers), warmup(warmup), listenFd(-1), spawned(0), numPeaks(0), checkShards(false) {}
+    void setShardCheck(bool enable) { checkShards = enable; }
+    bool run(const String &inputVideo);
+};
+
+bool runShardWorker(BlockMatchingCorrelation &engine, const String &socketPath, const String &inputVideo);
+
+#define SHARD_VECTORS_FILE "shard-vectors.mvf"
+
+#endif
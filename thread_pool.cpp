@@ -0,0 +1,105 @@
+/*
+****************************************
+* This file contains the definitions of
+* the work-stealing thread pool.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include "thread_pool.hpp"
+
+using namespace std;
+
+static thread_local int workerIndex = -1; // index of the worker running on this thread, -1 for other threads
+
+WorkStealingPool::WorkStealingPool(int numThreads) : queued(0), pending(0), stopping(false), nextWorker(0)
+{
+    if (numThreads < 1)
+        numThreads = 1;
+    for (int k = 0; k < numThreads; k++)
+        workers.emplace_back(new Worker());
+    for (int k = 0; k < numThreads; k++)
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, k);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        lock_guard<mutex> guard(waitLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto &t : threads)
+        t.join();
+}
+
+void WorkStealingPool::submit(function<void()> task)
+{
+    // a worker keeps the tasks it submits (continuations) in its own queue
+    int index = workerIndex >= 0 ? workerIndex : (int)(nextWorker++ % workers.size());
+    {
+        lock_guard<mutex> guard(workers[index]->lock);
+        workers[index]->tasks.push_back(move(task));
+    }
+    {
+        lock_guard<mutex> guard(waitLock);
+        queued++;
+        pending++;
+    }
+    wakeUp.notify_one();
+}
+
+bool WorkStealingPool::popTask(int index, function<void()> &task)
+{
+    int n = (int)workers.size();
+    for (int k = 0; k < n; k++)
+    {
+        // the own queue is used as a stack, the others are stolen from the front
+        Worker &worker = *workers[(index + k) % n];
+        lock_guard<mutex> guard(worker.lock);
+        if (worker.tasks.empty())
+            continue;
+        if (k == 0)
+        {
+            task = move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+        else
+        {
+            task = move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(int index)
+{
+    workerIndex = index;
+    while (1)
+    {
+        {
+            unique_lock<mutex> guard(waitLock);
+            wakeUp.wait(guard, [this] { return stopping || queued > 0; });
+            if (queued == 0)
+                return; // stopping and nothing left to run
+            queued--;
+        }
+        // a task is reserved for this worker, find it in any queue
+        function<void()> task;
+        while (!popTask(index, task))
+            this_thread::yield();
+        task();
+
+        lock_guard<mutex> guard(waitLock);
+        if (--pending == 0)
+            allDone.notify_all();
+    }
+}
+
+void WorkStealingPool::wait()
+{
+    unique_lock<mutex> guard(waitLock);
+    allDone.wait(guard, [this] { return pending == 0; });
+}
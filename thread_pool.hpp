@@ -0,0 +1,54 @@
+/*
+****************************************
+* This file contains the declaration
+* of the work-stealing thread pool.
+* Every worker has its own queue of
+* tasks, an idle worker takes tasks
+* from the queues of the others.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class WorkStealingPool
+{
+    struct Worker
+    {
+        deque<function<void()>> tasks;
+        mutex lock;
+    };
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    mutex waitLock;
+    condition_variable wakeUp, allDone;
+    int queued;              // tasks waiting in the queues, guarded by waitLock
+    int pending;             // tasks queued or running, guarded by waitLock
+    bool stopping;
+    atomic<unsigned> nextWorker;
+
+    bool popTask(int index, function<void()> &task);
+    void workerLoop(int index);
+
+public:
+    WorkStealingPool(int numThreads);
+    ~WorkStealingPool();
+    void submit(function<void()> task);
+    void wait(); // blocks until every submitted task has run
+    int size() const { return (int)threads.size(); }
+};
+
+#endif
@@ -0,0 +1,338 @@
+/*
+****************************************
+* This file contains the definitions of
+* the tile scheduler used for inputs
+* larger than FRAME_WIDTH x FRAME_HEIGHT.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#include "tiling.hpp"
+#include "util.hpp"
+#include "metrics.hpp"
+#include "motion_compensation.hpp"
+
+using namespace cv;
+using namespace std;
+
+bool needsTiling(Size inputSize)
+{
+    // inputs smaller than the engine's frame size in one dimension are resized instead
+    return inputSize.width >= FRAME_WIDTH && inputSize.height >= FRAME_HEIGHT && inputSize.area() > FRAME_WIDTH * FRAME_HEIGHT;
+}
+
+int numFrameBlocks(int length)
+{
+    // blocks are BLOCK_SIZE apart, the last one is aligned to the end of the frame (as in divideIntoBlocks)
+    return (length - BLOCK_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE + 1;
+}
+
+int frameBlockPos(int index, int length)
+{
+    return min(index * BLOCK_SIZE, length - BLOCK_SIZE);
+}
+
+static void tileAxis(int length, int tileLength, vector<int> &origins, vector<int> &bounds)
+{
+    // the fewest tiles that cover length, spread evenly with the first and last tiles on the frame edges
+    int n = 1;
+    if (length > tileLength)
+        n = (int)ceil((double)(length - TILE_MIN_OVERLAP) / (tileLength - TILE_MIN_OVERLAP));
+
+    origins.clear();
+    for (int k = 0; k < n; k++)
+        origins.push_back(n == 1 ? 0 : (int)((long)k * (length - tileLength) / (n - 1)));
+
+    // each tile owns the pixels up to the middle of its overlap with the next tile
+    bounds.assign(1, 0);
+    for (int k = 1; k < n; k++)
+        bounds.push_back((origins[k - 1] + tileLength + origins[k]) / 2);
+    bounds.push_back(length);
+}
+
+static void tileWeights(int length, int tileLength, const vector<int> &origins, vector<vector<float>> &weights)
+{
+    // every tile fades in and out linearly over its overlaps with the neighboring tiles,
+    // the weights of the tiles that cover a pixel add up to 1
+    int n = (int)origins.size();
+    weights.assign(n, vector<float>(length, 0.0f));
+    for (int x = 0; x < length; x++)
+    {
+        float sum = 0;
+        for (int k = 0; k < n; k++)
+        {
+            int start = origins[k], end = origins[k] + tileLength;
+            if (x < start || x >= end)
+                continue;
+            float w = 1.0f;
+            if (k > 0)
+                w = min(w, (x - start + 0.5f) / max(1, origins[k - 1] + tileLength - start));
+            if (k < n - 1)
+                w = min(w, (end - x - 0.5f) / max(1, end - origins[k + 1]));
+            weights[k][x] = w;
+            sum += w;
+        }
+        for (int k = 0; k < n; k++)
+            weights[k][x] /= sum;
+    }
+}
+
+void TiledInterpolator::layoutTiles(Size size)
+{
+    vector<int> originsX, originsY;
+
+    frameSize = size;
+    tileAxis(size.width, FRAME_WIDTH, originsX, boundsX);
+    tileAxis(size.height, FRAME_HEIGHT, originsY, boundsY);
+    tileWeights(size.width, FRAME_WIDTH, originsX, weightsX);
+    tileWeights(size.height, FRAME_HEIGHT, originsY, weightsY);
+    tilesX = (int)originsX.size();
+
+    tiles.clear();
+    engines.clear();
+    for (int y : originsY)
+    {
+        for (int x : originsX)
+        {
+            tiles.push_back(Rect(x, y, FRAME_WIDTH, FRAME_HEIGHT));
+            engines.emplace_back(new BlockMatchingCorrelation(""));
+            engines.back()->copySettings(settings);
+            engines.back()->setVerbose(false);
+        }
+    }
+    frameMV.assign(numFrameBlocks(size.height), vector<Point2f>(numFrameBlocks(size.width), Point2f(0, 0)));
+}
+
+int TiledInterpolator::ownerOf(Point p) const
+{
+    int tx = 0, ty = 0;
+    while (tx < tilesX - 1 && p.x >= boundsX[tx + 1])
+        tx++;
+    while (ty < (int)boundsY.size() - 2 && p.y >= boundsY[ty + 1])
+        ty++;
+    return ty * tilesX + tx;
+}
+
+Point2f TiledInterpolator::tileVector(int k, Point p) const
+{
+    // vector that tile k found for its block containing p, a point of the frame
+    Point local = p - tiles[k].tl();
+    int ii = min(max(local.y, 0) / BLOCK_SIZE, NUM_BLOCKS_Y - 1);
+    int jj = min(max(local.x, 0) / BLOCK_SIZE, NUM_BLOCKS_X - 1);
+    return engines[k]->getBlockMV()[ii][jj];
+}
+
+void TiledInterpolator::exchangeSeamVectors()
+{
+    Point halfBlock(BLOCK_SIZE / 2, BLOCK_SIZE / 2);
+
+    // the vector of every block of the frame comes from the tile that owns its center
+    for (int i = 0; i < (int)frameMV.size(); i++)
+    {
+        for (int j = 0; j < (int)frameMV[i].size(); j++)
+        {
+            Point center = Point(frameBlockPos(j, frameSize.width), frameBlockPos(i, frameSize.height)) + halfBlock;
+            frameMV[i][j] = tileVector(ownerOf(center), center);
+        }
+    }
+
+    // blocks in the overlap of two tiles take the vector of the owning tile, so that both
+    // tiles start the next frame pair from the same neighbors
+    for (int k = 0; k < (int)tiles.size(); k++)
+    {
+        vector<vector<Point2f>> blockMV = engines[k]->getBlockMV();
+        for (int ii = 0; ii < NUM_BLOCKS_Y; ii++)
+        {
+            for (int jj = 0; jj < NUM_BLOCKS_X; jj++)
+            {
+                Point center = tiles[k].tl() + Point(jj * BLOCK_SIZE, frameBlockPos(ii, FRAME_HEIGHT)) + halfBlock;
+                if (ownerOf(center) == k)
+                    continue;
+                int i = min(center.y / BLOCK_SIZE, (int)frameMV.size() - 1);
+                int j = min(center.x / BLOCK_SIZE, (int)frameMV[0].size() - 1);
+                blockMV[ii][jj] = frameMV[i][j];
+            }
+        }
+        engines[k]->setBlockMV(blockMV);
+    }
+}
+
+void TiledInterpolator::motionEstimation(const UMat &prev, const UMat &curr)
+{
+    if (prev.size() != frameSize)
+        layoutTiles(prev.size());
+
+    // the tiles are independent until their vectors are exchanged
+    parallel_for_(Range(0, (int)tiles.size()), [&](const Range &range) {
+        for (int k = range.start; k < range.end; k++)
+            engines[k]->motionEstimation(prev(tiles[k]), curr(tiles[k]));
+    });
+    exchangeSeamVectors();
+}
+
+void TiledInterpolator::motionCompensation(const UMat &prev, const UMat &curr, UMat &interpolatedFrame, double t)
+{
+    // same blocks as bidirectionalMotionCompensation, but over the whole frame so that
+    // blocks near a seam can take their pixels from the neighboring tile. A block in the overlap
+    // of several tiles is compensated with the vector of each of them, the results are blended
+    // with the weights of the tiles so that no seam is left between two differing vectors
+    Mat prevMat = prev.getMat(ACCESS_READ);
+    Mat currMat = curr.getMat(ACCESS_READ);
+    Mat newFrame = Mat::zeros(frameSize, prevMat.type());
+    int rows = (int)frameMV.size(), cols = (int)frameMV[0].size();
+    int cn = prevMat.channels();
+    Point halfBlock(BLOCK_SIZE / 2, BLOCK_SIZE / 2);
+
+    // the tile columns (or rows) that cover part of the block starting at start
+    auto covering = [](const vector<vector<float>> &weights, int start, vector<int> &found) {
+        found.clear();
+        for (int k = 0; k < (int)weights.size(); k++)
+            if (weights[k][start] > 0 || weights[k][start + BLOCK_SIZE - 1] > 0)
+                found.push_back(k);
+    };
+
+    auto compensateRows = [&](const Range &range) {
+        Mat region, region32f, blended;
+        vector<int> columns, rowTiles;
+        for (int i = range.start; i < range.end; i++)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                Rect block(frameBlockPos(j, frameSize.width), frameBlockPos(i, frameSize.height), BLOCK_SIZE, BLOCK_SIZE);
+                covering(weightsX, block.x, columns);
+                covering(weightsY, block.y, rowTiles);
+                if (columns.size() == 1 && rowTiles.size() == 1)
+                {
+                    compensateBlock(prevMat, currMat, block, frameMV[i][j], t, newFrame);
+                    continue;
+                }
+                blended = Mat::zeros(block.size(), CV_32FC(cn));
+                for (int ty : rowTiles)
+                {
+                    for (int tx : columns)
+                    {
+                        interpolateBlock(prevMat, currMat, block, tileVector(ty * tilesX + tx, block.tl() + halfBlock), t, region);
+                        region.convertTo(region32f, CV_32F);
+                        for (int y = 0; y < BLOCK_SIZE; y++)
+                        {
+                            float wy = weightsY[ty][block.y + y];
+                            const float *src = region32f.ptr<float>(y);
+                            float *dst = blended.ptr<float>(y);
+                            for (int x = 0; x < BLOCK_SIZE; x++)
+                            {
+                                float w = wy * weightsX[tx][block.x + x];
+                                for (int c = 0; c < cn; c++)
+                                    dst[x * cn + c] += w * src[x * cn + c];
+                            }
+                        }
+                    }
+                }
+                blended.convertTo(newFrame(block), prevMat.type());
+            }
+        }
+    };
+    // the last row overlaps the one above it and is written last, as in bidirectionalMotionCompensation
+    parallel_for_(Range(0, rows - 1), compensateRows);
+    compensateRows(Range(rows - 1, rows));
+
+    newFrame.copyTo(interpolatedFrame);
+}
+
+void TiledInterpolator::interpolate(const String &inputVideo)
+{
+    int rateFactor = settings.getRateFactor();
+    float newFPS = rateFactor * getInputFPS(inputVideo);
+    int firstFrame, lastFrame;
+    if (!settings.getFrameRange(firstFrame, lastFrame))
+        exit(-1);
+    int warmFirst = max(0, firstFrame - SEGMENT_WARMUP);
+
+    // the frames are decoded one pair at a time at their resolution, only the current pair is held
+    FrameStream stream;
+    UMat prevFrame, currFrame;
+    if (!stream.open(inputVideo, warmFirst, lastFrame, true) || !stream.read(prevFrame))
+        prevFrame.release();
+    while (!prevFrame.empty() && stream.position() <= firstFrame)
+    {
+        if (!stream.read(currFrame))
+        {
+            prevFrame.release();
+            break;
+        }
+        motionEstimation(prevFrame, currFrame); // warm-up before the requested span
+        prevFrame = currFrame;
+        currFrame = UMat();
+    }
+    bool havePair = !prevFrame.empty() && stream.read(currFrame);
+    if (!havePair)
+    {
+        cout << "The video has no frame pair in the requested range" << endl;
+        exit(-1);
+    }
+    rotateFile(EXEC_TIME_FILE, EXEC_TIME_MAX_BYTES, EXEC_TIME_KEEP);
+    ofstream execFile(EXEC_TIME_FILE, ios_base::app);
+
+    if (settings.usesVectorFiles())
+        cout << "Motion vector files are not supported for inputs larger than " << FRAME_WIDTH << "x" << FRAME_HEIGHT << ", they are ignored" << endl;
+    if (prevFrame.size() != frameSize)
+        layoutTiles(prevFrame.size());
+    getMetrics().beginRun(inputVideo, (lastFrame < 0 ? getFrameCount(inputVideo) - 1 : lastFrame) - firstFrame);
+    cout << "Input of " << frameSize.width << "x" << frameSize.height << " is split into " << tiles.size() << " tiles" << endl;
+
+    // the output goes to the image sequence or the video as it is produced
+    int outputFrames = 0;
+    VideoWriter interpolatedVideo;
+    if (!isImageSequence(inputVideo))
+        interpolatedVideo.open(INTERPOLATED_VIDEO, VideoWriter::fourcc('X', 'V', 'I', 'D'), newFPS, frameSize);
+    auto writeFrame = [&](const UMat &frame) {
+        if (isImageSequence(inputVideo))
+        {
+            // the frames keep their bit depth
+            if (!imwrite(format(INTERPOLATED_IMAGES, outputFrames), frame))
+            {
+                cout << "Could not write " << format(INTERPOLATED_IMAGES, outputFrames) << endl;
+                exit(-1);
+            }
+        }
+        else
+        {
+            interpolatedVideo << frame;
+        }
+        outputFrames++;
+    };
+
+    UMat interpolatedFrame;
+    while (havePair)
+    {
+        int prevIndex = stream.position() - 2;
+        auto start = chrono::high_resolution_clock::now();
+
+        cout << "Interpolating between frames : " << prevIndex << " and " << prevIndex + 1 << endl;
+        motionEstimation(prevFrame, currFrame);
+        writeFrame(prevFrame);
+        for (int k = 1; k < rateFactor; k++)
+        {
+            motionCompensation(prevFrame, currFrame, interpolatedFrame, (double)k / rateFactor);
+            writeFrame(interpolatedFrame);
+        }
+
+        auto stop = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
+        writeToFile(execFile, duration);
+        getMetrics().pairDone(prevIndex, StageTimes(), (double)duration.count()); // the stages run per tile
+
+        prevFrame = currFrame;
+        currFrame = UMat();
+        havePair = stream.read(currFrame);
+    }
+    writeFrame(prevFrame);
+    execFile.close();
+
+    if (isImageSequence(inputVideo))
+    {
+        cout << "...completed the new image sequence\nRelative Path of output images :" << INTERPOLATED_IMAGES << endl;
+        return;
+    }
+    interpolatedVideo.release();
+    cout << "...completed the new video\nRelative Path of output video :" << INTERPOLATED_VIDEO << endl;
+}
@@ -0,0 +1,54 @@
+/*
+****************************************
+* This file contains the declaration
+* of the tile scheduler used for inputs
+* larger than FRAME_WIDTH x FRAME_HEIGHT
+* (4K, 8K). The frame is split into
+* tiles of the engine's frame size,
+* motion estimation runs on all tiles
+* concurrently and motion compensation
+* runs on the whole frame, blending the
+* vectors of neighboring tiles across
+* their overlap.
+* Author : Shehyaaz Khan Nayazi
+****************************************
+*/
+
+#ifndef TILING_HPP
+#define TILING_HPP
+
+#include <opencv2/core.hpp>
+#include <memory>
+#include "bmc.hpp"
+
+using namespace cv;
+using namespace std;
+
+class TiledInterpolator
+{
+    const BlockMatchingCorrelation &settings;
+    vector<unique_ptr<BlockMatchingCorrelation>> engines; // one engine per tile
+    vector<Rect> tiles;                                   // tile rectangles in the frame
+    vector<int> boundsX, boundsY;                         // seams between the tiles, in the middle of their overlap
+    vector<vector<float>> weightsX, weightsY;             // blending weight of every tile column / row at every pixel
+    int tilesX;
+    Size frameSize;
+    vector<vector<Point2f>> frameMV; // motion vectors of the blocks of the whole frame
+
+    void layoutTiles(Size size);
+    int ownerOf(Point p) const;
+    Point2f tileVector(int k, Point p) const;
+    void exchangeSeamVectors();
+
+public:
+    TiledInterpolator(const BlockMatchingCorrelation &settings) : settings(settings), tilesX(0) {}
+    void motionEstimation(const UMat &prev, const UMat &curr);
+    void motionCompensation(const UMat &prev, const UMat &curr, UMat &interpolatedFrame, double t = 0.5);
+    void interpolate(const String &inputVideo);
+};
+
+bool needsTiling(Size inputSize);
+int numFrameBlocks(int length);
+int frameBlockPos(int index, int length);
+
+#endif
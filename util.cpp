@@ -11,17 +11,65 @@
 #include <opencv2/videoio.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <iostream>
 #include <fstream>
+#include <cfloat>
+#include <cstdio>
+#include <sys/stat.h>
 #include "constants.hpp"
 #include "opencv_methods.hpp"
 #include "util.hpp"
+#include "frame_cache.hpp"
 
 using namespace cv;
 using namespace std;
 
+bool SADCache::lookup(Point d, int &value)
+{
+    lookups++;
+    for (int k = 0; k < count; k++)
+    {
+        if (displacement[k] == d)
+        {
+            value = SAD[k];
+            hits++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SADCache::insert(Point d, int value)
+{
+    if (count == SAD_CACHE_SIZE)
+        return;
+    displacement[count] = d;
+    SAD[count] = value;
+    count++;
+}
+
+bool isImageSequence(const String &videoFile)
+{
+    // a printf pattern such as "frames/%06d.png", 16-bit images keep their depth
+    return videoFile.find('%') != String::npos;
+}
+
+static int firstSequenceIndex(const String &pattern)
+{
+    // sequences are numbered from 0 or from 1
+    for (int index = 0; index <= 1; index++)
+        if (!imread(format(pattern.c_str(), index), IMREAD_REDUCED_GRAYSCALE_8).empty())
+            return index;
+    cout << "Error opening the image sequence " << pattern << endl;
+    exit(-1);
+}
+
 float getInputFPS(const String &videoFile)
 {
+    if (isImageSequence(videoFile))
+        return IMAGE_SEQUENCE_FPS;
     VideoCapture cap(videoFile);
     // check if video opened successfully
     if (!cap.isOpened())
@@ -31,40 +79,278 @@ float getInputFPS(const String &videoFile)
     }
     return (float)cap.get(CAP_PROP_FPS);
 }
-void readFrames(const String &videoFile, vector<UMat> &frames)
+Size getInputSize(const String &videoFile)
 {
-    /* reads the images from the video folder */
+    if (isImageSequence(videoFile))
+        return imread(format(videoFile.c_str(), firstSequenceIndex(videoFile)), IMREAD_ANYDEPTH | IMREAD_COLOR).size();
     VideoCapture cap(videoFile);
-    bool HD = true;
     // check if video opened successfully
     if (!cap.isOpened())
     {
         cout << "Error opening video stream or file" << endl;
         exit(-1);
     }
-    if (cap.get(CAP_PROP_FRAME_WIDTH) != FRAME_WIDTH || cap.get(CAP_PROP_FRAME_HEIGHT) != FRAME_HEIGHT)
-        HD = false;
+    return Size((int)cap.get(CAP_PROP_FRAME_WIDTH), (int)cap.get(CAP_PROP_FRAME_HEIGHT));
+}
 
-    while (1)
+int getFrameCount(const String &videoFile)
+{
+    /* number of frames reported by the container, an image sequence is counted up to its first missing image */
+    struct stat st;
+    if (isImageSequence(videoFile))
     {
-        UMat fr;
-        cap >> fr;
-        // If the frame is empty, break immediately
-        if (fr.empty())
-            break;
-        if (!HD)
-            resize(fr, fr, Size(FRAME_WIDTH, FRAME_HEIGHT));
-        frames.push_back(fr);
+        int start = firstSequenceIndex(videoFile), count = 0;
+        while (stat(format(videoFile.c_str(), start + count).c_str(), &st) == 0)
+            count++;
+        return count;
+    }
+    VideoCapture cap(videoFile);
+    return cap.isOpened() ? (int)cap.get(CAP_PROP_FRAME_COUNT) : 0;
+}
+
+void readFrames(const String &videoFile, vector<UMat> &frames, bool keepSize)
+{
+    /* reads the images from the video folder, frames are resized to FRAME_WIDTH x FRAME_HEIGHT unless keepSize is set */
+    readFrameRange(videoFile, frames, 0, -1, keepSize);
+}
+
+bool FrameStream::open(const String &file, int first, int lastFrame, bool keepFrameSize)
+{
+    /* places the stream on first, the capture seeks so that only the frames back to the previous key frame are
+       decoded. False if the video cannot be opened or has no frame first */
+    videoFile = file;
+    next = first;
+    last = lastFrame;
+    keepSize = keepFrameSize;
+    cached.clear();
+    cacheHandle.reset(); // the mapping of the last input is released once no other stream reads it
+    cap.release();
+    if (isImageSequence(videoFile))
+    {
+        start = firstSequenceIndex(videoFile);
+        return true;
+    }
+    if (frameCacheEnabled())
+    {
+        // the frames are mapped from the cache, later runs on the same input do not decode it
+        if (cachedFrames(videoFile, keepSize ? getInputSize(videoFile) : Size(FRAME_WIDTH, FRAME_HEIGHT), cached, cacheHandle))
+            return first < (int)cached.size();
+    }
+    if (!cap.open(videoFile))
+        return false;
+    return first == 0 || seekFrame(cap, videoFile, first);
+}
+
+bool FrameStream::read(UMat &frame)
+{
+    /* the next frame of the range, false after last or at the end of the input */
+    if (last >= 0 && next > last)
+        return false;
+    if (isImageSequence(videoFile))
+    {
+        // the images are read with their depth, 10 to 16-bit masters stay CV_16UC3
+        imread(format(videoFile.c_str(), start + next), IMREAD_ANYDEPTH | IMREAD_COLOR).copyTo(frame);
+    }
+    else if (!cached.empty())
+    {
+        if (next >= (int)cached.size())
+            return false;
+        frame = cached[next].getUMat(ACCESS_READ);
+    }
+    else
+    {
+        cap >> frame;
+    }
+    if (frame.empty())
+        return false;
+    if (!keepSize && frame.size() != Size(FRAME_WIDTH, FRAME_HEIGHT))
+        resize(frame, frame, Size(FRAME_WIDTH, FRAME_HEIGHT));
+    next++;
+    return true;
+}
+
+void readFrameRange(const String &videoFile, vector<UMat> &frames, int first, int last, bool keepSize)
+{
+    /* reads the frames first to last (last < 0 for the end of the video) */
+    FrameStream stream;
+    UMat fr;
+    if (!stream.open(videoFile, first, last, keepSize))
+    {
+        cout << "The video " << videoFile << " could not be opened or has no frame " << first << endl;
+        exit(-1);
+    }
+    while (stream.read(fr))
+    {
+        frames.push_back(stream.isCached() ? fr.clone() : fr); // the list outlives the mapping of the cache
+        fr = UMat(); // the next frame gets its own buffer
         // Press  ESC on keyboard to  exit
         char c = (char)waitKey(1);
         if (c == 27)
             break;
     }
-    // release the video
+}
+
+int parseFramePosition(const String &position, double fps)
+{
+    /* a frame number ("450") or a time stamp ("15s", "15.5s", "1:05", "00:01:05.25"), -1 if invalid */
+    double seconds = 0, value;
+    char *end;
+    const char *p = position.c_str();
+
+    if (position.empty())
+        return -1;
+    if (position.find(':') == String::npos && position.back() != 's')
+    {
+        long frame = strtol(p, &end, 10);
+        return (*end == '\0' && end != p && frame >= 0) ? (int)frame : -1;
+    }
+    while (1)
+    {
+        value = strtod(p, &end);
+        if (end == p || value < 0)
+            return -1;
+        seconds = seconds * 60 + value;
+        if (*end != ':')
+            break;
+        p = end + 1;
+    }
+    if (!(*end == '\0' || (*end == 's' && end[1] == '\0')) || fps <= 0)
+        return -1;
+    return (int)round(seconds * fps);
+}
+
+bool readFrame(VideoCapture &cap, UMat &frame)
+{
+    /* reads the next frame of cap, resized to FRAME_WIDTH x FRAME_HEIGHT as in readFrames */
+    cap >> frame;
+    if (frame.empty())
+        return false;
+    if (frame.cols != FRAME_WIDTH || frame.rows != FRAME_HEIGHT)
+        resize(frame, frame, Size(FRAME_WIDTH, FRAME_HEIGHT));
+    return true;
+}
+
+bool seekFrame(VideoCapture &cap, const String &videoFile, int frame)
+{
+    /* places cap so that its next frame is frame. Seeking a long-GOP stream is not always frame accurate,
+       the decoder may stop on the key frame before frame, so the position is checked after the seek.
+       If it is wrong the video is opened again and decoded from its start, counting the frames */
+    if (cap.set(CAP_PROP_POS_FRAMES, frame) && (int)round(cap.get(CAP_PROP_POS_FRAMES)) == frame)
+        return true;
     cap.release();
+    if (!cap.open(videoFile))
+        return false;
+    for (int n = 0; n < frame; n++)
+    {
+        if (!cap.grab()) // decoded but not converted
+            return false;
+    }
+    return true;
 }
 
-vector<Point2f> phaseCorr(InputArray _src1, InputArray _src2, InputArray _window, double *response = 0)
+static bool insertPeak(vector<Point> &peakLoc, vector<float> &peakVal, int numPeaks, int minDistance, Point p, float v)
+{
+    // non-maximum suppression : a peak closer than minDistance to a stronger one is dropped,
+    // weaker peaks close to the new one are removed from the list. Returns true if the list shrank
+    size_t before = peakLoc.size();
+    size_t k = 0;
+    while (k < peakLoc.size())
+    {
+        if (abs(peakLoc[k].x - p.x) < minDistance && abs(peakLoc[k].y - p.y) < minDistance)
+        {
+            if (peakVal[k] >= v)
+                return false;
+            peakLoc.erase(peakLoc.begin() + k);
+            peakVal.erase(peakVal.begin() + k);
+        }
+        else
+            k++;
+    }
+    // keep the list sorted in descending order
+    k = 0;
+    while (k < peakVal.size() && peakVal[k] >= v)
+        k++;
+    peakLoc.insert(peakLoc.begin() + k, p);
+    peakVal.insert(peakVal.begin() + k, v);
+    if ((int)peakLoc.size() > numPeaks)
+    {
+        peakLoc.pop_back();
+        peakVal.pop_back();
+    }
+    return peakLoc.size() < before;
+}
+
+static vector<Point> rescanPeaks(const Mat &C, int numPeaks, int minDistance)
+{
+    /* one scan of C per peak, the highest value outside the neighbourhoods of the peaks found so far */
+    vector<Point> peakLoc;
+    Mat mask(C.size(), CV_8UC1, Scalar(255));
+    Rect surface(0, 0, C.cols, C.rows);
+    for (int k = 0; k < numPeaks; k++)
+    {
+        double v;
+        Point p(-1, -1);
+        minMaxLoc(C, 0, &v, 0, &p, mask);
+        if (p.x < 0)
+            break;
+        peakLoc.push_back(p);
+        Rect window(p.x - minDistance + 1, p.y - minDistance + 1, 2 * minDistance - 1, 2 * minDistance - 1);
+        mask(window & surface).setTo(0);
+    }
+    return peakLoc;
+}
+
+vector<Point> findPeaks(const Mat &C, int numPeaks, int minDistance)
+{
+    /* finds the numPeaks highest, separated peaks of C in a single scan */
+    CV_Assert(C.type() == CV_32FC1);
+
+    vector<Point> peakLoc;
+    vector<float> peakVal;
+    float threshold = -FLT_MAX; // a value must exceed this to enter the list
+    bool full = false;          // values were skipped or dropped since the list was full
+    bool lost = false;          // the list shrank after that, the skipped values may have belonged in it
+
+    auto add = [&](Point p, float v) {
+        if (insertPeak(peakLoc, peakVal, numPeaks, minDistance, p, v) && full)
+            lost = true;
+        full = full || (int)peakVal.size() == numPeaks;
+        threshold = (int)peakVal.size() == numPeaks ? peakVal.back() : -FLT_MAX;
+    };
+
+    for (int y = 0; y < C.rows && !lost; y++)
+    {
+        const float *row = C.ptr<float>(y);
+        int x = 0;
+#if CV_SIMD128
+        v_float32x4 vThreshold = v_setall_f32(threshold);
+        for (; x <= C.cols - 4; x += 4)
+        {
+            // most of the surface is below the threshold, so four values are rejected at once
+            if (!v_check_any(v_load(row + x) > vThreshold))
+                continue;
+            for (int k = x; k < x + 4; k++)
+            {
+                if (row[k] > threshold)
+                    add(Point(k, y), row[k]);
+            }
+            vThreshold = v_setall_f32(threshold);
+        }
+#endif
+        for (; x < C.cols; x++)
+        {
+            if (row[x] > threshold)
+                add(Point(x, y), row[x]);
+        }
+    }
+    // a strong peak that suppressed two kept ones leaves room for values skipped under the old threshold,
+    // they are only found again by scanning once per peak, as before the single scan
+    if (lost)
+        return rescanPeaks(C, numPeaks, minDistance);
+    return peakLoc;
+}
+
+vector<Point2f> phaseCorr(InputArray _src1, InputArray _src2, InputArray _window, double *response = 0, int numPeaks)
 {
     /* performs customised phase plane correlation on the input frames */
     UMat src1 = _src1.getMat().getUMat(ACCESS_WRITE);
@@ -127,35 +413,40 @@ vector<Point2f> phaseCorr(InputArray _src1, InputArray _src2, InputArray _window
 
     fftShift(C); // shift the energy to the center of the frame.
 
-    // locate the highest peak
-    Point peakLoc;
-    // return two peak locations
-    minMaxLoc(C, NULL, NULL, NULL, &peakLoc);
+    // adjust shift relative to image center...
+    Point2f center((double)padded1.cols / 2.0, (double)padded1.rows / 2.0);
+    vector<Point2f> shifts;
 
-    // get the phase shift with sub-pixel accuracy, 5x5 window seems about right here...
-    Point2f t1, t2;
-    t1 = weightedCentroid(C, peakLoc, Size(5, 5), response);
-    C.getMat(ACCESS_WRITE).at<float>(peakLoc) = 0; // set the value at peakLoc to 0
-    minMaxLoc(C, NULL, NULL, NULL, &peakLoc);      // find second peakLoc
-    t2 = weightedCentroid(C, peakLoc, Size(5, 5), response);
+    {
+        Mat surface = C.getMat(ACCESS_READ);
+        // locate the numPeaks highest peaks
+        vector<Point> peakLoc = findPeaks(surface, numPeaks, PEAK_SEPARATION);
+
+        // get the phase shift with sub-pixel accuracy, 5x5 window seems about right here...
+        for (size_t k = 0; k < peakLoc.size(); k++)
+        {
+            Point2f t = weightedCentroid(surface, peakLoc[k], Size(5, 5), k == 0 ? response : NULL); // response is that of the highest peak
+            shifts.push_back(center - t);
+        }
+    }
+    // a flat surface can have fewer separated peaks, repeat the best one
+    while ((int)shifts.size() < numPeaks)
+        shifts.push_back(shifts.empty() ? Point2f(0, 0) : shifts[0]);
 
     // max response is M*N (not exactly, might be slightly larger due to rounding errors)
     if (response)
         *response /= M * N;
 
-    // adjust shift relative to image center...
-    Point2f center((double)padded1.cols / 2.0, (double)padded1.rows / 2.0);
-
-    return {(center - t1), (center - t2)};
+    return shifts;
 }
 
-float calcSAD(const UMat &prevBlock, int rowpos, int colpos, const UMat &curr, float dx, float dy)
+int calcSAD(const UMat &prevBlock, int rowpos, int colpos, const UMat &curr, float dx, float dy)
 {
     CV_Assert(prevBlock.type() == curr.type());
     CV_Assert(prevBlock.type() == CV_32FC1 || prevBlock.type() == CV_64FC1);
 
     UMat currBlock, absDiff;
-    float SAD = 0.0; // to store SAD value
+    double SAD = 0.0; // to store SAD value, the sums of float pixels are whole numbers
     int dx_int = (int)round(dx);
     int dy_int = (int)round(dy);
     int x = colpos * BLOCK_SIZE;
@@ -174,9 +465,104 @@ float calcSAD(const UMat &prevBlock, int rowpos, int colpos, const UMat &curr, f
         absdiff(prevBlock, currBlock, absDiff); // absDiff = prevBlock - currBlock
         SAD = sum(absDiff)[0];
     }
+    return (int)round(SAD);
+}
+
+template <typename T>
+static inline unsigned rowSAD(const T *row1, const T *row2, int n);
+
+template <>
+inline unsigned rowSAD<uchar>(const uchar *row1, const uchar *row2, int n)
+{
+    unsigned SAD = 0;
+    int x = 0;
+#if CV_SIMD128
+    for (; x <= n - 16; x += 16)
+        SAD += v_reduce_sad(v_load(row1 + x), v_load(row2 + x));
+#endif
+    for (; x < n; x++)
+        SAD += abs(row1[x] - row2[x]);
     return SAD;
 }
 
+template <>
+inline unsigned rowSAD<ushort>(const ushort *row1, const ushort *row2, int n)
+{
+    // 8 lanes of 16 bits, the same bytes per instruction as the 8-bit path
+    unsigned SAD = 0;
+    int x = 0;
+#if CV_SIMD128
+    for (; x <= n - 8; x += 8)
+        SAD += v_reduce_sad(v_load(row1 + x), v_load(row2 + x));
+#endif
+    for (; x < n; x++)
+        SAD += abs(row1[x] - row2[x]);
+    return SAD;
+}
+
+template <typename T>
+int blockSAD(const Mat &block1, const Mat &block2, int limit)
+{
+    /* SAD of two blocks of the same size and pixel type, accumulated in integers.
+       Once the running sum reaches limit the remaining rows are skipped and the partial sum is returned */
+    CV_Assert(block1.type() == DataType<T>::type && block2.type() == DataType<T>::type);
+    CV_Assert(block1.size() == block2.size());
+
+    unsigned SAD = 0;
+    for (int y = 0; y < block1.rows; y++)
+    {
+        SAD += rowSAD<T>(block1.ptr<T>(y), block2.ptr<T>(y), block1.cols);
+        if (SAD >= (unsigned)limit)
+            break;
+    }
+    return (int)SAD;
+}
+
+template int blockSAD<uchar>(const Mat &block1, const Mat &block2, int limit);
+template int blockSAD<ushort>(const Mat &block1, const Mat &block2, int limit);
+
+int blockSADInt(const Mat &block1, const Mat &block2, int limit)
+{
+    // 8-bit luma, or 10 to 16-bit luma stored in 16 bits
+    if (block1.depth() == CV_16U)
+        return blockSAD<ushort>(block1, block2, limit);
+    return blockSAD<uchar>(block1, block2, limit);
+}
+
+double pixelLevelScale(int depth)
+{
+    // full range of the pixel type over the 8-bit range, 10 and 12-bit content is stored MSB-aligned in 16 bits
+    return depth == CV_16U ? 65535.0 / 255.0 : 1.0;
+}
+
+int calcSADInt(const Mat &prevBlock, int rowpos, int colpos, const Mat &curr, int dx, int dy, int limit)
+{
+    /* integer version of calcSAD, the displacement is already rounded */
+    int x = colpos * BLOCK_SIZE;
+    int y = rowpos * BLOCK_SIZE;
+    if (y > curr.rows - BLOCK_SIZE && y < curr.rows)
+    {
+        y = curr.rows - BLOCK_SIZE;
+    }
+    if (x + dx >= curr.cols || y + dy >= curr.rows || x + dx <= -1 * BLOCK_SIZE || y + dy <= -1 * BLOCK_SIZE)
+    {
+        return (int)sum(prevBlock)[0];
+    }
+    return blockSADInt(prevBlock, getPaddedROI(curr, x + dx, y + dy, BLOCK_SIZE, BLOCK_SIZE), limit);
+}
+
+int regionSADInt(const Mat &prev, const Mat &curr, Rect region, Point d, int limit)
+{
+    /* calcSADInt for a region of any size, region lies inside prev and is displaced by d in curr */
+    int x = region.x + d.x;
+    int y = region.y + d.y;
+    if (x >= curr.cols || y >= curr.rows || x <= -1 * region.width || y <= -1 * region.height)
+    {
+        return (int)sum(prev(region))[0];
+    }
+    return blockSADInt(prev(region), getPaddedROI(curr, x, y, region.width, region.height), limit);
+}
+
 Point2f medianNeighbor(int rowpos, int colpos, vector<vector<Point2f>> &prevBlockMV)
 {
     // median of Point(x,y) = {median of x-coordinates, median of y-coordinates}
@@ -230,6 +616,17 @@ Point2f medianNeighbor(int rowpos, int colpos, vector<vector<Point2f>> &prevBloc
     return median;
 }
 
+void rotateFile(const String &file, size_t maxBytes, int keep)
+{
+    /* once file has grown past maxBytes it becomes file.1, file.1 becomes file.2 and so on up to file.keep */
+    struct stat info;
+    if (stat(file.c_str(), &info) != 0 || (size_t)info.st_size < maxBytes)
+        return;
+    for (int k = keep - 1; k >= 1; k--)
+        rename(format("%s.%d", file.c_str(), k).c_str(), format("%s.%d", file.c_str(), k + 1).c_str());
+    rename(file.c_str(), (file + ".1").c_str());
+}
+
 void writeToFile(ofstream &file, chrono::milliseconds duration)
 {
     if (!file)
@@ -240,14 +637,20 @@ void writeToFile(ofstream &file, chrono::milliseconds duration)
     file << "Interpolated frame in :" << duration.count() << " milliseconds \n";
 }
 
-UMat getPaddedROI(const UMat &input, int top_left_x, int top_left_y, int width, int height, Scalar paddingColor)
+double msSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+template <typename MatType>
+static MatType paddedROI(const MatType &input, int top_left_x, int top_left_y, int width, int height, Scalar paddingColor)
 {
     //cout << "\n My inputs are top_left_x = " << top_left_x << " top_left_y = " << top_left_y << " width = " << width << " height = " << height << "\n";
     //int w = width, h = height;
     int bottom_right_x = top_left_x + width;
     int bottom_right_y = top_left_y + height;
 
-    UMat output;
+    MatType output;
     if (top_left_x < 0 || top_left_y < 0 || bottom_right_x > input.cols || bottom_right_y > input.rows)
     {
         // border padding will be required
@@ -294,6 +697,16 @@ UMat getPaddedROI(const UMat &input, int top_left_x, int top_left_y, int width,
     return output;
 }
 
+UMat getPaddedROI(const UMat &input, int top_left_x, int top_left_y, int width, int height, Scalar paddingColor)
+{
+    return paddedROI(input, top_left_x, top_left_y, width, height, paddingColor);
+}
+
+Mat getPaddedROI(const Mat &input, int top_left_x, int top_left_y, int width, int height, Scalar paddingColor)
+{
+    return paddedROI(input, top_left_x, top_left_y, width, height, paddingColor);
+}
+
 /*
 cv::Point2d cv::phaseCorrelate(InputArray _src1, InputArray _src2, InputArray _window, double* response)
 {
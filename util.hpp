@@ -15,19 +15,73 @@
 #include "opencv2/imgproc.hpp"
 #include <iostream>
 #include <fstream>
+#include <climits>
+#include <chrono>
 #include "constants.hpp"
 #include "opencv_methods.hpp"
+#include "frame_cache.hpp"
 
 using namespace cv;
 using namespace std;
 
+// SADs already computed for the current block, keyed by integer displacement
+struct SADCache
+{
+    Point displacement[SAD_CACHE_SIZE];
+    int SAD[SAD_CACHE_SIZE];
+    int count;
+    size_t hits, lookups;
+
+    SADCache() : count(0), hits(0), lookups(0) {}
+    void clear() { count = 0; }
+    bool lookup(Point d, int &value);
+    void insert(Point d, int value);
+};
+
+// the frames of a video or an image sequence from first to last (-1 for the end), one at a time,
+// resized to FRAME_WIDTH x FRAME_HEIGHT unless keepSize is set
+class FrameStream
+{
+    String videoFile;
+    VideoCapture cap;
+    vector<Mat> cached;           // frames mapped from the frame cache
+    FrameCacheHandle cacheHandle; // the cache file stays mapped while a stream reads it
+    int start;          // index of the first image of a sequence
+    int next, last;
+    bool keepSize;
+
+public:
+    FrameStream() : start(0), next(0), last(-1), keepSize(false) {}
+    bool open(const String &videoFile, int first, int last = -1, bool keepSize = false);
+    bool read(UMat &frame);
+    int position() const { return next; } // index of the frame the next read returns
+    bool isCached() const { return !cached.empty(); } // the frames read point into the cache, valid while the stream is open
+};
+
+bool isImageSequence(const String &videoFile);
 float getInputFPS(const String &videoFile);
-void readFrames(const String &videoFile, vector<UMat> &frames);
-vector<Point2f> phaseCorr(InputArray _src1, InputArray _src2, InputArray _window, double *response);
-float calcSAD(const UMat &prevBlock, int rowpos, int colpos, const UMat &curr, float dx, float dy);
+Size getInputSize(const String &videoFile);
+int getFrameCount(const String &videoFile);
+void readFrames(const String &videoFile, vector<UMat> &frames, bool keepSize = false);
+void readFrameRange(const String &videoFile, vector<UMat> &frames, int first, int last, bool keepSize = false);
+bool readFrame(VideoCapture &cap, UMat &frame);
+bool seekFrame(VideoCapture &cap, const String &videoFile, int frame);
+int parseFramePosition(const String &position, double fps);
+vector<Point> findPeaks(const Mat &C, int numPeaks, int minDistance);
+vector<Point2f> phaseCorr(InputArray _src1, InputArray _src2, InputArray _window, double *response, int numPeaks = PHASE_CORR_PEAKS);
+int calcSAD(const UMat &prevBlock, int rowpos, int colpos, const UMat &curr, float dx, float dy);
+template <typename T>
+int blockSAD(const Mat &block1, const Mat &block2, int limit = INT_MAX); // T is uchar or ushort
+int blockSADInt(const Mat &block1, const Mat &block2, int limit = INT_MAX);
+double pixelLevelScale(int depth);
+int calcSADInt(const Mat &prevBlock, int rowpos, int colpos, const Mat &curr, int dx, int dy, int limit = INT_MAX);
+int regionSADInt(const Mat &prev, const Mat &curr, Rect region, Point d, int limit = INT_MAX);
 Point2f medianNeighbor(int rowpos, int colpos, vector<vector<Point2f>> &prevBlockMV);
 bool validROI(const UMat &frame, const Rect &roi);
 UMat getPaddedROI(const UMat &input, int top_left_x, int top_left_y, int width, int height, Scalar paddingColor = Scalar(0.0));
+Mat getPaddedROI(const Mat &input, int top_left_x, int top_left_y, int width, int height, Scalar paddingColor = Scalar(0.0));
+void rotateFile(const String &file, size_t maxBytes, int keep);
 void writeToFile(ofstream &file, chrono::milliseconds duration);
+double msSince(chrono::steady_clock::time_point start);
 
 #endif